@@ -6,6 +6,13 @@
 #include <sstream>
 #include <cstring>
 #include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <thread>
+#include <vector>
 
 #ifdef _MSC_VER
 #include <intrin.h>
@@ -13,6 +20,10 @@
 #include <x86intrin.h>
 #endif
 
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
 /*
     This is our board representation 
     8 | a8 b8 c8 d8 e8 f8 g8 h8
@@ -37,9 +48,6 @@
 #define takeBack(board, backup) \
     memcpy(board, &backup, sizeof(Board));
 
-static U64 repetitionTable[1024];
-static int repetitionIndex = 0;
-
 struct Board{
     U64 bitboards[12]; // 12 types of pieces (6 white, 6 black)
     U64 occupancies[4]; // 0: white, 1: black, 2: all, 3: empty
@@ -48,8 +56,54 @@ struct Board{
     int enPassantSquare; // Square for en passant capture
     int halfMoveClock; // Half-move clock for the fifty-move rule
     U64 zobristHash; // Zobrist hash for the board state
+    U64 pawnHash; // Zobrist hash of the pawns only, keys the pawn structure cache
+    int psqtScore[2]; // Running MG/EG material + piece-square score, white minus black
+    int phase[2]; // Running game-phase weight of each side's pieces
+    int material[2]; // Running endgame material of each side
+    uint8_t pieceOn[64]; // Piece on each square, none if empty
+};
+
+// Irreversible state saved by makeMove and restored by unmakeMove, so the search
+// only keeps this per ply instead of a full Board copy
+struct StateInfo {
+    U64 zobristHash;
+    U64 pawnHash;
+    uint16_t halfMoveClock;
+    uint8_t capturedPiece; // none if the move was not a capture
+    uint8_t castlingRights;
+    uint8_t enPassantSquare;
 };
 
+// Hashes of the positions before each move played so far, oldest first, for repetition
+// detection. Every game owns its history, so boards can be set up on any thread at once.
+// A repetition can only reach back halfMoveClock plies, so once the history is full only the
+// most recent gameHistoryKeep entries are kept, which covers any clock the 50-move rule allows.
+#define gameHistorySize 1024
+#define gameHistoryKeep 256
+
+struct GameHistory {
+    U64 hashes[gameHistorySize];
+    int count;
+};
+
+static inline void pushGameHistory(GameHistory *history, U64 hash) {
+    if (history->count == gameHistorySize) {
+        memmove(history->hashes, history->hashes + gameHistorySize - gameHistoryKeep, sizeof(U64) * gameHistoryKeep);
+        history->count = gameHistoryKeep;
+    }
+    history->hashes[history->count++] = hash;
+}
+
+// Whether the board is the third occurrence of its position; only positions since the last
+// irreversible move with the same side to move can match
+static inline bool isThreefoldRepetition(const Board *board, const GameHistory *history) {
+    int limit = std::max(0, history->count - board->halfMoveClock);
+    int count = 1;
+    for (int i = history->count - 2; i >= limit; i -= 2)
+        if (history->hashes[i] == board->zobristHash && ++count >= 3) return true;
+    return false;
+}
+
 
 // Zobrist Hashing Constants
 static U64 pieceZobristKeys[12][64];
@@ -58,23 +112,23 @@ static U64 castlingZobristKeys[16];
 static U64 sideZobristKey;
 
 static inline void initializeRandomKeys() {
-    randomState = 1804289383; // reset random state
+    zobristRandomState = 0x9E3779B97F4A7C15ULL; // reset random state
     for (int piece = P; piece <= k; ++piece){
         for (int square = 0; square < 64; ++square) {
-            pieceZobristKeys[piece][square] = generateRandomU64();
+            pieceZobristKeys[piece][square] = generateZobristKey();
         }
     }
 
     for (int square = 0; square < 64; ++square) {
-        enpassantZobristKeys[square] = generateRandomU64();
+        enpassantZobristKeys[square] = generateZobristKey();
     }
 
     enpassantZobristKeys[noSquare] = 0ULL; // No en passant square
 
-    sideZobristKey = generateRandomU64();
+    sideZobristKey = generateZobristKey();
 
     for (int i = 0; i < 16; ++i) {
-        castlingZobristKeys[i] = generateRandomU64();
+        castlingZobristKeys[i] = generateZobristKey();
     }
 }
 
@@ -100,14 +154,72 @@ static inline U64 computeZobristHash(const Board *board) {
     return hash;
 }
 
+// Material + piece-square score of each piece on each square from white's point of view
+// (MG/EG), each piece's game-phase weight and its endgame material. Filled by the
+// evaluation (initializePieceSquareScores) so makeMove can keep the Board sums current.
+static int pieceSquareScore[2][12][64];
+static int piecePhase[12];
+static int pieceMaterial[12];
+
+static inline void addPieceScores(Board *board, int piece, int square) {
+    board->psqtScore[0] += pieceSquareScore[0][piece][square];
+    board->psqtScore[1] += pieceSquareScore[1][piece][square];
+    board->phase[piece >= p] += piecePhase[piece];
+    board->material[piece >= p] += pieceMaterial[piece];
+}
+
+static inline void removePieceScores(Board *board, int piece, int square) {
+    board->psqtScore[0] -= pieceSquareScore[0][piece][square];
+    board->psqtScore[1] -= pieceSquareScore[1][piece][square];
+    board->phase[piece >= p] -= piecePhase[piece];
+    board->material[piece >= p] -= pieceMaterial[piece];
+}
+
+static inline void movePieceScores(Board *board, int piece, int from, int to) {
+    board->psqtScore[0] += pieceSquareScore[0][piece][to] - pieceSquareScore[0][piece][from];
+    board->psqtScore[1] += pieceSquareScore[1][piece][to] - pieceSquareScore[1][piece][from];
+}
+
+static inline void refreshPieceScores(Board *board) {
+    board->psqtScore[0] = board->psqtScore[1] = 0;
+    board->phase[white] = board->phase[black] = 0;
+    board->material[white] = board->material[black] = 0;
+    for (int piece = P; piece <= k; ++piece) {
+        U64 bitboard = board->bitboards[piece];
+        while (bitboard) {
+            int square = getLSBindex(bitboard);
+            addPieceScores(board, piece, square);
+            popBit(bitboard, square);
+        }
+    }
+}
+
+static inline U64 computePawnHash(const Board *board) {
+    U64 hash = 0ULL;
+    for (int piece = P; piece <= p; piece += p - P) {
+        U64 bitboard = board->bitboards[piece];
+        while (bitboard) {
+            int square = getLSBindex(bitboard);
+            hash ^= pieceZobristKeys[piece][square];
+            popBit(bitboard, square);
+        }
+    }
+    return hash;
+}
+
 static inline void clearBoard(Board* board) {
     memset(board->bitboards, 0, sizeof(board->bitboards));
     memset(board->occupancies, 0, sizeof(board->occupancies));
+    memset(board->pieceOn, none, sizeof(board->pieceOn));
 
     board->sideToMove = white; // Default to white
     board->castlingRights = 0; // No castling rights
     board->enPassantSquare = noSquare; // No en passant square
     board->zobristHash = 0ULL; // Reset Zobrist hash
+    board->pawnHash = 0ULL;
+    memset(board->psqtScore, 0, sizeof(board->psqtScore));
+    memset(board->phase, 0, sizeof(board->phase));
+    memset(board->material, 0, sizeof(board->material));
     board->halfMoveClock = 0; // Reset half-move clock
 }
 
@@ -117,13 +229,7 @@ static inline std::string boardToFEN(Board* board) {
         int emptyCount = 0;
         for (int file = 0; file < 8; ++file) {
             int square = rank * 8 + file;
-            int piece = none;
-            for (int bbIndex = 0; bbIndex < 12; ++bbIndex) {
-                if (getBit(board->bitboards[bbIndex], square)) {
-                    piece = bbIndex;
-                    break;
-                }
-            }
+            int piece = board->pieceOn[square];
             if (piece == none) {
                 emptyCount++;
             } else {
@@ -157,7 +263,6 @@ static inline std::string boardToFEN(Board* board) {
 }
 
 static inline void printBoard(Board* board) {
-    U64* bitboards = board->bitboards;
     int sideToMove = board->sideToMove;
     int castlingRights = board->castlingRights;
     int enPassantSquare = board->enPassantSquare;
@@ -167,13 +272,7 @@ static inline void printBoard(Board* board) {
         std::cout << rank + 1 << "  ";
         for (int file = 0; file < 8; ++file) {
             int square = rank * 8 + file;
-            int piece = none;
-            for (int bbIndex = 0; bbIndex < 12; ++bbIndex) {
-                if (getBit(bitboards[bbIndex], square)) {
-                    piece = bbIndex;
-                    break;
-                }
-            }
+            int piece = board->pieceOn[square];
             if (piece != none) std::cout << asciiPieces[piece] << " ";
             else std::cout << ". ";
         }
@@ -203,7 +302,6 @@ static inline void printBoard(Board* board) {
 
 static inline void parseFEN(Board* board, const std::string& fen) {
     clearBoard(board);
-    repetitionIndex = 0;
     std::istringstream iss(fen);
     std::string boardPart, side, castling, enPassant, halfMoveClock;;
     iss >> boardPart >> side >> castling >> enPassant >> halfMoveClock;
@@ -219,6 +317,7 @@ static inline void parseFEN(Board* board, const std::string& fen) {
         } else {
             int piece = pieceMap.at(c);
             setBit(board->bitboards[piece], square);
+            board->pieceOn[square] = (uint8_t)piece;
             square++;
         }
     }
@@ -257,6 +356,8 @@ static inline void parseFEN(Board* board, const std::string& fen) {
 
     // Update the Zobrist hash
     board -> zobristHash = computeZobristHash(board);
+    board->pawnHash = computePawnHash(board);
+    refreshPieceScores(board);
 }
 
 // Hash Flags
@@ -278,32 +379,46 @@ static inline bool ttMoveMatch(int move, uint16_t ttMove) {
     return compressed == ttMove;
 }
 
+// depth8 holds depth + ttDepthOffset so that 0 marks an empty slot, leaving every
+// generation/bound combination in genBound usable
+#define ttDepthOffset 1
+#define ttBucketEntries 6
+
 struct TTEntry {
     uint16_t key16;
     int16_t  value;
     int16_t  staticEval;
     uint16_t move;
-    int8_t   depth;
-    uint8_t  genBound;
+    uint8_t  depth8;
+    uint8_t  genBound; // generation (upper 6 bits) | bound (lower 2 bits)
 };
 
 static_assert(sizeof(TTEntry) == 10, "TTEntry must be 10 bytes");
 
+// Six entries fill 60 bytes of the cache line; the last 4 bytes hold 5 extra key bits
+// per entry, so an entry is verified with 21 key bits on top of the bucket index.
+// keyExtra is shared by all six entries and threads store into the same bucket
+// concurrently, so it is atomic and each store only touches its own 5 bits.
 struct TTBucket {
-    TTEntry entries[4];
-    uint8_t padding[24];
+    TTEntry entries[ttBucketEntries];
+    std::atomic<uint32_t> keyExtra;
 };
 
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "TTBucket is cleared with memset");
+
 static_assert(sizeof(TTBucket) == 64, "TTBucket must be 64 bytes (one cache line)");
 
 static TTBucket *TranspositionTable = NULL;
-static uint32_t ttNumBuckets = 0;
-static uint32_t ttBucketMask = 0;
+static uint64_t ttNumBuckets = 0;
 static uint8_t ttGeneration = 0;
-static uint32_t ttUsedEntries = 0;
 
+// Multiply-high maps the key onto [0, ttNumBuckets), so the table can have any size
 static inline TTBucket* getTTBucket(U64 key) {
-    return &TranspositionTable[(key >> 32) & ttBucketMask];
+#if defined(_MSC_VER)
+    return &TranspositionTable[__umulh(key, ttNumBuckets)];
+#else
+    return &TranspositionTable[(uint64_t)(((unsigned __int128)key * ttNumBuckets) >> 64)];
+#endif
 }
 
 static inline void ttPrefetch(U64 key) {
@@ -314,28 +429,111 @@ static inline void ttPrefetch(U64 key) {
 #endif
 }
 
+static inline uint32_t ttKeyExtra(U64 key) {
+    return (uint32_t)(key >> 16) & 0x1F;
+}
+
+static inline bool ttEntryMatches(const TTBucket *bucket, int i, uint16_t key16, uint32_t keyExtra) {
+    const TTEntry &e = bucket->entries[i];
+    return e.depth8 != 0 && e.key16 == key16 &&
+           ((bucket->keyExtra.load(std::memory_order_relaxed) >> (5 * i)) & 0x1F) == keyExtra;
+}
+
+static inline void setTTEntryKey(TTBucket *bucket, int i, uint16_t key16, uint32_t keyExtra) {
+    bucket->entries[i].key16 = key16;
+    uint32_t shift = 5 * i;
+    uint32_t old = bucket->keyExtra.load(std::memory_order_relaxed);
+    while (!bucket->keyExtra.compare_exchange_weak(old, (old & ~(0x1Fu << shift)) | (keyExtra << shift),
+                                                   std::memory_order_relaxed)) {}
+}
+
 static inline void incrementTTGeneration() {
     ttGeneration += 4; // lower 2 bits reserved for bound type
 }
 
 static inline int ttEntryQuality(const TTEntry &e) {
     int ageDelta = ((ttGeneration & 0xFC) - (e.genBound & 0xFC)) & 0xFC;
-    return (int)e.depth - (ageDelta >> 2) * 4 + ((e.genBound & 3) == hashExact ? 2 : 0);
+    return (int)e.depth8 - ttDepthOffset - (ageDelta >> 2) * 4 + ((e.genBound & 3) == hashExact ? 2 : 0);
 }
 
+#define hugePageSize (2 * 1024 * 1024)
+
+static int ttRequestedMB = 0;
+static bool ttNeedsClear = false;
+
+// Zeroes the table with one thread per hardware thread, each on its own 2 MB aligned
+// slice. The first write to a page decides its NUMA node, so the first clear after
+// allocation also spreads the table over the nodes those threads run on.
 static inline void clearTranspositionTable() {
+    if (TranspositionTable != NULL) {
+        char *base = (char *)TranspositionTable;
+        size_t bytes = ttNumBuckets * sizeof(TTBucket);
+        size_t threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = std::min(threads, (bytes + hugePageSize - 1) / hugePageSize);
+        size_t slice = (bytes / threads + hugePageSize - 1) / hugePageSize * hugePageSize;
+
+        std::vector<std::thread> workers;
+        for (size_t start = slice; start < bytes; start += slice) {
+            size_t length = std::min(slice, bytes - start);
+            workers.emplace_back([base, start, length] { memset(base + start, 0, length); });
+        }
+        memset(base, 0, std::min(slice, bytes));
+        for (std::thread &worker : workers)
+            worker.join();
+    }
+    ttNeedsClear = false;
+}
+
+// Allocates on a 2 MB boundary and asks Linux for transparent huge pages, which cuts
+// the TLB misses of random TT accesses on big tables
+static inline void *allocateLargePages(size_t size) {
+    size = (size + hugePageSize - 1) / hugePageSize * hugePageSize;
+#if defined(_WIN32)
+    return _aligned_malloc(size, hugePageSize);
+#else
+    void *mem = std::aligned_alloc(hugePageSize, size);
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    if (mem != NULL)
+        madvise(mem, size, MADV_HUGEPAGE);
+#endif
+    return mem;
+#endif
+}
+
+static inline void freeLargePages(void *mem) {
+#if defined(_WIN32)
+    _aligned_free(mem);
+#else
+    std::free(mem);
+#endif
+}
+
+static inline void freeTranspositionTable() {
     if (TranspositionTable != NULL)
-        memset(TranspositionTable, 0, (size_t)ttNumBuckets * sizeof(TTBucket));
-    ttUsedEntries = 0;
+        freeLargePages(TranspositionTable);
+    TranspositionTable = NULL;
+    ttNumBuckets = 0;
 }
 
-static inline uint32_t roundDownPow2(uint32_t v) {
-    v |= v >> 1;
-    v |= v >> 2;
-    v |= v >> 4;
-    v |= v >> 8;
-    v |= v >> 16;
-    return (v >> 1) + 1;
+// Kilobytes of the table backed by huge pages, read from /proc/self/smaps. Only
+// meaningful after the table has been touched (cleared); 0 where unsupported.
+static inline uint64_t ttHugePageKB() {
+    uint64_t total = 0;
+#ifdef __linux__
+    uint64_t tableStart = (uint64_t)(uintptr_t)TranspositionTable;
+    uint64_t tableEnd = tableStart + ttNumBuckets * sizeof(TTBucket);
+    std::ifstream smaps("/proc/self/smaps");
+    std::string line;
+    bool inTable = false;
+    while (std::getline(smaps, line)) {
+        unsigned long long lo, hi, kb;
+        if (sscanf(line.c_str(), "%llx-%llx ", &lo, &hi) == 2 && line.find(':') > line.find(' '))
+            inTable = lo < tableEnd && hi > tableStart;
+        else if (inTable && sscanf(line.c_str(), "AnonHugePages: %llu kB", &kb) == 1)
+            total += kb;
+    }
+#endif
+    return total;
 }
 
 static inline void initializeTranspositionSize(int MB) {
@@ -343,28 +541,51 @@ static inline void initializeTranspositionSize(int MB) {
         std::cout << "Invalid size for transposition table, must be greater than 0 MB" << std::endl;
         return;
     }
-    uint32_t totalBuckets = (uint32_t)((uint64_t)MB * 1024 * 1024 / sizeof(TTBucket));
-    ttNumBuckets = roundDownPow2(totalBuckets);
-    ttBucketMask = ttNumBuckets - 1;
+    freeTranspositionTable();
 
-    if (TranspositionTable != NULL) {
-        delete[] TranspositionTable;
-    }
-    TranspositionTable = new TTBucket[ttNumBuckets];
+    ttNumBuckets = (uint64_t)MB * 1024 * 1024 / sizeof(TTBucket);
+    TranspositionTable = (TTBucket *)allocateLargePages(ttNumBuckets * sizeof(TTBucket));
     if (TranspositionTable == NULL) {
         std::cout << "Failed to allocate memory for transposition table, trying " << MB / 2 << " MB" << std::endl;
         initializeTranspositionSize(MB / 2);
     } else {
         clearTranspositionTable();
         std::cout << "Transposition table initialized with " << ttNumBuckets
-                  << " buckets (" << ttNumBuckets * 4 << " entries)." << std::endl;
+                  << " buckets (" << ttNumBuckets * ttBucketEntries << " entries), "
+                  << ttHugePageKB() / 1024 << " MB on huge pages." << std::endl;
+    }
+}
+
+// Hash size changes and ucinewgame only record what is wanted; the work is done by
+// prepareTranspositionTable on the next isready/go, so a burst of setoption commands
+// allocates and clears the table once
+static inline void requestTranspositionSize(int MB) {
+    ttRequestedMB = MB;
+}
+
+static inline void requestTranspositionClear() {
+    ttNeedsClear = true;
+}
+
+static inline void prepareTranspositionTable() {
+    if (ttRequestedMB > 0) {
+        initializeTranspositionSize(ttRequestedMB);
+        ttRequestedMB = 0;
+    } else if (ttNeedsClear) {
+        clearTranspositionTable();
     }
 }
 
+// Permille of occupied entries, sampled from the first buckets so that writers share no
+// counter; keys spread evenly over the table, so the sample stands for the whole
 static inline int hashfull() {
-    uint32_t totalEntries = ttNumBuckets * 4;
-    if (totalEntries == 0) return 0;
-    return (int)((uint64_t)ttUsedEntries * 1000 / totalEntries);
+    uint64_t buckets = std::min<uint64_t>(ttNumBuckets, (1000 + ttBucketEntries - 1) / ttBucketEntries);
+    if (buckets == 0) return 0;
+    uint64_t used = 0;
+    for (uint64_t b = 0; b < buckets; b++)
+        for (int i = 0; i < ttBucketEntries; i++)
+            used += TranspositionTable[b].entries[i].depth8 != 0;
+    return (int)(used * 1000 / (buckets * ttBucketEntries));
 }
 
 struct TTProbeResult {
@@ -383,11 +604,12 @@ static inline TTProbeResult probeHashEntry(Board *board, int alpha, int beta, in
 
     U64 key = board->zobristHash;
     uint16_t key16 = (uint16_t)(key & 0xFFFF);
+    uint32_t keyExtra = ttKeyExtra(key);
     TTBucket *bucket = getTTBucket(key);
 
-    for (int i = 0; i < 4; i++) {
+    for (int i = 0; i < ttBucketEntries; i++) {
         TTEntry *entry = &bucket->entries[i];
-        if (entry->key16 == key16 && entry->genBound != 0) {
+        if (ttEntryMatches(bucket, i, key16, keyExtra)) {
             result.hit = true;
 
             if (entry->move != 0)
@@ -396,7 +618,7 @@ static inline TTProbeResult probeHashEntry(Board *board, int alpha, int beta, in
             if (entry->staticEval != (int16_t)-32768)
                 result.ttEval = (int)entry->staticEval;
 
-            if (entry->depth >= depth) {
+            if ((int)entry->depth8 - ttDepthOffset >= depth) {
                 int value = (int)entry->value;
 
                 if (value < -MATESCORE) value += ply;
@@ -425,6 +647,7 @@ static inline TTProbeResult probeHashEntry(Board *board, int alpha, int beta, in
 static inline void writeHashEntry(Board *board, int bestMove, int value, int depth, int flag, int ply = 0, int staticEval = -32768) {
     U64 key = board->zobristHash;
     uint16_t key16 = (uint16_t)(key & 0xFFFF);
+    uint32_t keyExtra = ttKeyExtra(key);
     TTBucket *bucket = getTTBucket(key);
 
     if (value < -MATESCORE) value -= ply;
@@ -435,40 +658,43 @@ static inline void writeHashEntry(Board *board, int bestMove, int value, int dep
     uint16_t storedMove = moveToTTMove(bestMove);
     uint8_t storedGenBound = (ttGeneration & 0xFC) | (flag & 3);
 
-    TTEntry *replace = &bucket->entries[0];
+    int replaceIndex = 0;
+    bool sameKey = false;
     int worstQuality = ttEntryQuality(bucket->entries[0]);
 
-    for (int i = 0; i < 4; i++) {
+    for (int i = 0; i < ttBucketEntries; i++) {
         TTEntry *entry = &bucket->entries[i];
 
-        if (entry->key16 == key16 || entry->genBound == 0) {
-            if (entry->genBound == 0)
-                ttUsedEntries++;
-            if (entry->key16 == key16 && storedMove == 0)
-                storedMove = entry->move;
-            if (entry->key16 == key16 && storedEval == (int16_t)-32768)
-                storedEval = entry->staticEval;
+        if (entry->depth8 == 0 || ttEntryMatches(bucket, i, key16, keyExtra)) {
+            if (entry->depth8 != 0) {
+                sameKey = true;
+                if (storedMove == 0)
+                    storedMove = entry->move;
+                if (storedEval == (int16_t)-32768)
+                    storedEval = entry->staticEval;
+            }
 
-            replace = entry;
+            replaceIndex = i;
             break;
         }
 
         int q = ttEntryQuality(*entry);
         if (q < worstQuality) {
             worstQuality = q;
-            replace = entry;
+            replaceIndex = i;
         }
     }
 
-    if (replace->key16 == key16 && replace->depth > depth + 2 &&
+    TTEntry *replace = &bucket->entries[replaceIndex];
+    if (sameKey && (int)replace->depth8 - ttDepthOffset > depth + 2 &&
         flag != hashExact && (replace->genBound & 3) == hashExact)
         return;
 
-    replace->key16 = key16;
+    setTTEntryKey(bucket, replaceIndex, key16, keyExtra);
     replace->value = storedValue;
     replace->staticEval = storedEval;
     replace->move = storedMove;
-    replace->depth = (int8_t)depth;
+    replace->depth8 = (uint8_t)std::max(0, std::min(254, depth) + ttDepthOffset);
     replace->genBound = storedGenBound;
 }
 
@@ -152,6 +152,9 @@ static inline void printBitboard(U64 bitboard) {
 #define TIME_IN_MICROSECONDS std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count()
 
 
+// <cmath> defines a floating-point INFINITY; pull it in first so ours always wins
+#include <cmath>
+#undef INFINITY
 #define INFINITY 32000 // Arbitrary large value for alpha-beta pruning but less than int
 #define MATEVALUE 31000 // Value for checkmate but less than int
 #define MATESCORE 30000 // Lower bound for mate score but less than int
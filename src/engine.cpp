@@ -13,7 +13,7 @@ using namespace std;
 static int parseMove(Board *board, const string &moveStr) {
     // Convert UCI move string like "e2e4", "e7e8q" into move integer
     MoveList moveList[1];
-    generateMoves(board, moveList);
+    generateLegalMoves(board, moveList);
 
     if (moveStr.length() < 4) return 0;
 
@@ -40,9 +40,12 @@ static int parseMove(Board *board, const string &moveStr) {
     return 0; // invalid move
 }
 
+// Positions before each move of the last "position" command, handed to the search
+static GameHistory gameHistory;
 
 static void parsePosition(Board *board, const string &input) {
     // Supports "position startpos moves ..." and "position fen ..."
+    gameHistory.count = 0;
 
     if (input.find("startpos") != string::npos) {
         parseFEN(board, "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
@@ -62,8 +65,9 @@ static void parsePosition(Board *board, const string &input) {
         while (ss >> moveStr) {
             int move = parseMove(board, moveStr);
             if (move) {
-                repetitionTable[repetitionIndex++] = board->zobristHash; // Store the Zobrist hash for repetition detection
-                makeMove(board, move);
+                pushGameHistory(&gameHistory, board->zobristHash); // Store the Zobrist hash for repetition detection
+                StateInfo undo;
+                makeMoveUnchecked(board, move, &undo);
             } else {
                 cerr << "Invalid move: " << moveStr << endl;
             }
@@ -135,18 +139,63 @@ static void parseGo(Board *board, const string &input, SearchUCI *searchParams)
     searchParams->quit = 0;
     searchParams->stop = 0;
 
-    searchPosition(board, searchParams);
+    searchPosition(board, &gameHistory, searchParams);
+}
+
+// Fixed positions searched to a fixed depth from a cleared hash table. The node count is a
+// signature of the search and the speed is a measure of the machine, which is what the match
+// runner calibrates time controls with.
+static const char *benchPositions[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r2q1rk1/ppp2ppp/2n1bn2/2b1p3/3pP3/3P1NPP/PPP1NPB1/R1BQ1RK1 b - - 0 9",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+};
+
+#define benchDepth 12
+
+// Returns true if a quit arrived while it ran. read_input records it in the global
+// searchParams, not in the copy the search was started from.
+static bool bench(Board *board, SearchUCI *benchParams, int depth) {
+    U64 nodes = 0;
+    bool quit = false;
+    long long start = TIME_IN_MILLISECONDS;
+    for (const char *fen : benchPositions) {
+        parsePosition(board, string("position fen ") + fen);
+        requestTranspositionClear();
+        prepareTranspositionTable();
+
+        benchParams->depth = depth;
+        benchParams->timedGame = 0;
+        benchParams->startTime = TIME_IN_MILLISECONDS;
+        benchParams->stopTime = benchParams->startTime;
+        benchParams->increment = 0;
+        searchPosition(board, &gameHistory, benchParams);
+        nodes += totalSearchedNodes();
+        quit = searchParams->quit; // stop is always set once a search ends
+        if (quit) break;
+    }
+    long long elapsed = std::max(1LL, TIME_IN_MILLISECONDS - start);
+
+    cout << "Nodes searched: " << nodes << endl;
+    cout << "Nodes/second: " << nodes * 1000 / elapsed << endl;
+    parsePosition(board, "position startpos");
+    requestTranspositionClear();
+    return quit;
 }
 
 static void uci(Board *board, SearchUCI *searchParams) {
 
-    int maxHashSize = 128;
+    int maxHashSize = 262144; // 256 GB
     int minHashSize = 4;
     int hashSize = 64; // Default hash size in MB
+    int threadCount = 1;
 
     cout << "id name Polarity" << endl;
     cout << "id author Magnet" << endl;
-    cout << "option name Hash type spin default 64 min 4 max 128" << endl;
+    cout << "option name Hash type spin default 64 min " << minHashSize << " max " << maxHashSize << endl;
+    cout << "option name Threads type spin default 1 min 1 max " << maxSearchThreads << endl;
     cout << "uciok" << endl;
     string input;
     while (getline(cin, input)) {
@@ -156,6 +205,7 @@ static void uci(Board *board, SearchUCI *searchParams) {
             cout << "id author Magnet" << endl;
             cout << "uciok" << endl;
         } else if (input == "isready") {
+            prepareTranspositionTable();
             cout << "readyok" << endl;
         } else if (input == "quit") {
             searchParams->quit = 1;
@@ -163,6 +213,7 @@ static void uci(Board *board, SearchUCI *searchParams) {
         } else if (input == "stop") {
             searchParams->stop = 1;
         }else if (input.rfind("go", 0) == 0) {
+            prepareTranspositionTable();
             parseGo(board, input, searchParams);
         } else if (input.rfind("position", 0) == 0) {
             //clearTranspositionTable();
@@ -176,16 +227,30 @@ static void uci(Board *board, SearchUCI *searchParams) {
                 depth = stoi(input.substr(pos + 6));
             }
             perftTest(board, depth, 1);
+        } else if (input.rfind("bench", 0) == 0) {
+            size_t pos = input.find(' ');
+            if (bench(board, searchParams, pos != string::npos ? stoi(input.substr(pos + 1)) : benchDepth)) {
+                searchParams->quit = 1;
+                break;
+            }
         } else if (input == "ucinewgame") {
             parsePosition(board, "position startpos");
-            clearTranspositionTable();
+            requestTranspositionClear();
         } else if (input.rfind("setoption name Hash value ", 0) == 0) {
             size_t pos = input.find("value ");
             if (pos != string::npos) {
                 hashSize = stoi(input.substr(pos + 6));
                 if (hashSize < minHashSize) hashSize = minHashSize;
                 if (hashSize > maxHashSize) hashSize = maxHashSize;
-                initializeTranspositionSize(hashSize);
+                requestTranspositionSize(hashSize);
+            }
+        } else if (input.rfind("setoption name Threads value ", 0) == 0) {
+            size_t pos = input.find("value ");
+            if (pos != string::npos) {
+                threadCount = stoi(input.substr(pos + 6));
+                if (threadCount < 1) threadCount = 1;
+                if (threadCount > maxSearchThreads) threadCount = maxSearchThreads;
+                initializeSearchThreads(threadCount);
             }
         } else {
             cout << "Unknown command: " << input << endl;
@@ -196,21 +261,33 @@ static void uci(Board *board, SearchUCI *searchParams) {
 static void initializeAll() {
     initializeMoveTables();
     initializeRandomKeys();
-    initializeTranspositionSize(64);
+    requestTranspositionSize(64);
     initializeEvaluationMasks();
+    initializeSearchThreads(1);
 }
 
-int main(){
+int main(int argc, char **argv){
     //cout << "Welcome to Polarity Chess Engine!" << endl;
     initializeAll();
     Board board;
     SearchUCI searchParams;
     searchParams.depth = 10; // Default search depth
+
+    // "engine bench [depth]" runs the bench and exits, for scripts
+    if (argc > 1 && string(argv[1]) == "bench") {
+        searchParams.pollInput = 0;
+        prepareTranspositionTable();
+        bench(&board, &searchParams, argc > 2 ? atoi(argv[2]) : benchDepth);
+        freeTranspositionTable();
+        delete[] searchThreads;
+        return 0;
+    }
     int uciMode = 1;
     if (uciMode) {
         parsePosition(&board, start_position);
         uci(&board, &searchParams);
-        delete[] TranspositionTable; // Clean up transposition table
+        freeTranspositionTable(); // Clean up transposition table
+        delete[] searchThreads;
         return 0; // Exit after UCI initialization
     }
 
@@ -222,6 +299,6 @@ int main(){
     printBoard(&board);
     //cout << evaluate(&board); // Initial evaluation
 
-    delete[] TranspositionTable; // Clean up transposition table
+    freeTranspositionTable(); // Clean up transposition table
     return 0;
 }
\ No newline at end of file
@@ -16,6 +16,32 @@
 #define EVAL_PARAM static const
 #endif
 
+#ifdef TUNING_MODE
+// Linear coefficient of one parameter in one evaluation. Anything evaluate() adds
+// without a TRACE is a constant as far as the tuner is concerned
+struct EvalTraceTerm {
+    const int *param;
+    int mg;
+    int eg;
+};
+
+struct EvalTrace {
+    std::vector<EvalTraceTerm> terms;
+    int phase;  // 0..24, as used for the MG/EG blend
+    int scale;  // endgame scale factor in percent
+    int tempo;  // +1/-1, tempoBonus is added after scaling
+    bool drawn; // insufficient material, the evaluation is a flat 0
+};
+
+// Set by the tuner on its worker threads; evaluate() only records when it is non-null
+static thread_local EvalTrace *evalTrace = NULL;
+
+#define TRACE(param, mgCount, egCount) \
+    do { if (evalTrace) evalTrace->terms.push_back({&(param), (mgCount), (egCount)}); } while (0)
+#else
+#define TRACE(param, mgCount, egCount) ((void)0)
+#endif
+
 const int mirrorSquare[] = {
     a8, b8, c8, d8, e8, f8, g8, h8,
     a7, b7, c7, d7, e7, f7, g7, h7,
@@ -35,7 +61,7 @@ EVAL_PARAM int pieceValue[2][12] = {
 const int phaseScore[12] = {0, 1, 1, 2, 4, 0, 0, 1, 1, 2, 4, 0};
 const int endGamePhaseMaterialScore = 2 * phaseScore[R] + phaseScore[B] + phaseScore[N];
 
-const int pawnSquareTable[2][64] = {
+EVAL_PARAM int pawnSquareTable[2][64] = {
     { // MGpawnSquareTable
          0,    0,   0,   0,   0,   0,   0,   0,
        -35,  -1, -20, -23, -15,  24,  38, -22,
@@ -58,7 +84,7 @@ const int pawnSquareTable[2][64] = {
     }
 };
 
-const int knightSquareTable[2][64] = {
+EVAL_PARAM int knightSquareTable[2][64] = {
     { // MGknightSquareTable
        -105, -21, -58, -33, -17, -28, -19,  -23,
         -29, -53, -12,  -3,  -1,  18, -14,  -19,
@@ -81,7 +107,7 @@ const int knightSquareTable[2][64] = {
     }
 };
 
-const int bishopSquareTable[2][64] = {
+EVAL_PARAM int bishopSquareTable[2][64] = {
     { // MGbishopSquareTable
         -33,  -3, -14, -21, -13, -12, -39, -21,
           4,  15,  16,   0,   7,  21,  33,   1,
@@ -104,7 +130,7 @@ const int bishopSquareTable[2][64] = {
     }
 };
 
-const int rookSquareTable[2][64] = {
+EVAL_PARAM int rookSquareTable[2][64] = {
     { // MGrookSquareTable
         -19, -13,   1,  17, 16,  7, -37, -26,
         -44, -16, -20,  -9, -1, 11,  -6, -71,
@@ -127,7 +153,7 @@ const int rookSquareTable[2][64] = {
     }
 };
 
-const int queenSquareTable[2][64] = {
+EVAL_PARAM int queenSquareTable[2][64] = {
     { // MGqueenSquareTable
          -1, -18,  -9,  10, -15, -25, -31, -50,  
         -35,  -8,  11,   2,   8,  15,  -3,   1,  
@@ -150,7 +176,7 @@ const int queenSquareTable[2][64] = {
     }
 };
 
-const int kingSquareTable[2][64] = {
+EVAL_PARAM int kingSquareTable[2][64] = {
     { // mg_king_table
         -15,  36,  12, -54,   8, -28,  24,  14,
           1,   7,  -8, -64, -43, -16,   9,   8,
@@ -264,6 +290,56 @@ EVAL_PARAM int kingSafetyTable[] = {
   271, 298, 327, 357, 388, 400, 400, 400, 400, 400
 };
 
+static const int (*pieceSquareTables[6])[64] = {
+    pawnSquareTable, knightSquareTable, bishopSquareTable, rookSquareTable, queenSquareTable, kingSquareTable
+};
+
+// Material + PST of one piece on one square from white's point of view
+static inline int pieceSquareValue(int stage, int piece, int square) {
+    if (piece < p)
+        return pieceValue[stage][piece] + pieceSquareTables[piece][stage][square];
+    return pieceValue[stage][piece] - pieceSquareTables[piece - p][stage][mirrorSquare[square]];
+}
+
+// Fills the tables behind Board's running material/PST/phase sums
+static inline void initializePieceSquareScores() {
+    for (int piece = P; piece <= k; ++piece) {
+        for (int square = 0; square < 64; ++square) {
+            pieceSquareScore[MG][piece][square] = pieceSquareValue(MG, piece, square);
+            pieceSquareScore[EG][piece][square] = pieceSquareValue(EG, piece, square);
+        }
+        piecePhase[piece] = phaseScore[piece];
+        pieceMaterial[piece] = std::abs(pieceValue[EG][piece]);
+    }
+}
+
+// The same sums computed from scratch with the current parameters, for the tuner
+static inline void computePieceScores(const Board *board, int pieceScores[2], int phases[2], int materials[2]) {
+    pieceScores[MG] = pieceScores[EG] = 0;
+    phases[white] = phases[black] = 0;
+    materials[white] = materials[black] = 0;
+    for (int piece = P; piece <= k; ++piece) {
+        U64 bitboard = board->bitboards[piece];
+        while (bitboard) {
+            int square = getLSBindex(bitboard);
+            pieceScores[MG] += pieceSquareValue(MG, piece, square);
+            pieceScores[EG] += pieceSquareValue(EG, piece, square);
+            phases[piece >= p] += phaseScore[piece];
+            materials[piece >= p] += std::abs(pieceValue[EG][piece]);
+#ifdef TUNING_MODE
+            // Black values are the negated white ones, so both colours trace the white entries
+            int type = piece % 6, sign = piece < p ? 1 : -1;
+            int tableSquare = piece < p ? square : mirrorSquare[square];
+            TRACE(pieceValue[MG][type], sign, 0);
+            TRACE(pieceValue[EG][type], 0, sign);
+            TRACE(pieceSquareTables[type][MG][tableSquare], sign, 0);
+            TRACE(pieceSquareTables[type][EG][tableSquare], 0, sign);
+#endif
+            popBit(bitboard, square);
+        }
+    }
+}
+
 static inline U64 setFileRankMasks(int file, int rank) {
     U64 mask = 0ULL;
     
@@ -301,6 +377,7 @@ static inline void initializeEvaluationMasks() {
             passedPawnMasks[black][rank * 8 + file] = (rank > 0) ? ppMask >> 8 * (8 - rank) : 0ULL;
         }
     }
+    initializePieceSquareScores();
 }
 
 static inline bool insufficientMaterial(Board *board) {
@@ -412,19 +489,213 @@ static inline int endgameScaleFactor(const Board *board, int score) {
     return 100;
 }
 
-static inline int evaluate(Board *board) {
+// Pawn structure terms that only depend on the pawn bitboards (doubled, duo, isolated,
+// backward, passed and connected passers). Search threads cache them under
+// the board's pawn key together with the passed pawns and pawn attacks, which the rest
+// of evaluate() reuses.
+struct PawnHashEntry {
+    U64 key;
+    U64 passedPawns[2];
+    U64 pawnAttacks[2];
+    int mgScore;
+    int egScore;
+};
+
+#define pawnHashEntries 8192 // per search thread, must be a power of two
+
+struct PawnHashTable {
+    PawnHashEntry entries[pawnHashEntries];
+    U64 probes;
+    U64 hits;
+};
+
+static inline void evaluatePawnStructure(const Board *board, PawnHashEntry *entry) {
+    int mgScore = 0;
+    int egScore = 0;
+    U64 passed[2] = {0ULL, 0ULL};
+    U64 pawnAttackMap[2] = {0ULL, 0ULL};
+    U64 bitboard;
+    int square;
+    int numPawnsOnFile;
+
+    bitboard = board->bitboards[P];
+    while (bitboard) {
+        square = getLSBindex(bitboard);
+        pawnAttackMap[white] |= pawnAttacks[white][square];
+
+        numPawnsOnFile = countBits(board->bitboards[P] & fileMasks[square]);
+        if (numPawnsOnFile > 1) {
+            for (int r = square / 8 - 1; r >= 0; --r) {
+                if (board->bitboards[P] & (1ULL << (r * 8 + square % 8))) {
+                    mgScore += doublePawnPenalty;
+                    egScore += doublePawnPenalty;
+                    TRACE(doublePawnPenalty, 1, 1);
+                    break;
+                }
+            }
+        }
+
+        {
+            int pFile = square % 8;
+            int pRank = square / 8;
+            if (pFile < 7 && (board->bitboards[P] & (1ULL << (pRank * 8 + pFile + 1)))) {
+                mgScore += pawnDuoBonus[0];
+                egScore += pawnDuoBonus[1];
+                TRACE(pawnDuoBonus[0], 1, 0);
+                TRACE(pawnDuoBonus[1], 0, 1);
+            }
+        }
+
+        if ((board->bitboards[P] & isolatedPawnMasks[square]) == 0) {
+            mgScore += isolatedPawnPenalty;
+            egScore += isolatedPawnPenalty;
+            TRACE(isolatedPawnPenalty, 1, 1);
+        } else if (square + 8 < 64 && (pawnAttacks[white][square + 8] & board->bitboards[p]) &&
+                   (board->bitboards[P] & isolatedPawnMasks[square] & ~passedPawnMasks[white][square]) == 0) {
+            mgScore += backwardPawnPenalty[0];
+            egScore += backwardPawnPenalty[1];
+            TRACE(backwardPawnPenalty[0], 1, 0);
+            TRACE(backwardPawnPenalty[1], 0, 1);
+        }
+
+        if (((board->bitboards[p] | (board->bitboards[P] & fileMasks[square])) & passedPawnMasks[white][square]) == 0) {
+            int rank = square / 8;
+            setBit(passed[white], square);
+            mgScore += passedPawnBonus[0][rank];
+            egScore += passedPawnBonus[1][rank];
+            TRACE(passedPawnBonus[0][rank], 1, 0);
+            TRACE(passedPawnBonus[1][rank], 0, 1);
+
+            U64 adjacentPassedFriendly = board->bitboards[P] & isolatedPawnMasks[square];
+            while (adjacentPassedFriendly) {
+                int adjSq = getLSBindex(adjacentPassedFriendly);
+                if (((board->bitboards[p] | (board->bitboards[P] & fileMasks[adjSq])) & passedPawnMasks[white][adjSq]) == 0) {
+                    mgScore += connectedPassedBonus[0];
+                    egScore += connectedPassedBonus[1];
+                    TRACE(connectedPassedBonus[0], 1, 0);
+                    TRACE(connectedPassedBonus[1], 0, 1);
+                    break;
+                }
+                popBit(adjacentPassedFriendly, adjSq);
+            }
+        }
+        popBit(bitboard, square);
+    }
+
+    bitboard = board->bitboards[p];
+    while (bitboard) {
+        square = getLSBindex(bitboard);
+        pawnAttackMap[black] |= pawnAttacks[black][square];
+
+        numPawnsOnFile = countBits(board->bitboards[p] & fileMasks[square]);
+        if (numPawnsOnFile > 1) {
+            for (int r = square / 8 + 1; r < 8; ++r) {
+                if (board->bitboards[p] & (1ULL << (r * 8 + square % 8))) {
+                    mgScore -= doublePawnPenalty;
+                    egScore -= doublePawnPenalty;
+                    TRACE(doublePawnPenalty, -1, -1);
+                    break;
+                }
+            }
+        }
+
+        {
+            int pFile = square % 8;
+            int pRank = square / 8;
+            if (pFile < 7 && (board->bitboards[p] & (1ULL << (pRank * 8 + pFile + 1)))) {
+                mgScore -= pawnDuoBonus[0];
+                egScore -= pawnDuoBonus[1];
+                TRACE(pawnDuoBonus[0], -1, 0);
+                TRACE(pawnDuoBonus[1], 0, -1);
+            }
+        }
+
+        if ((board->bitboards[p] & isolatedPawnMasks[square]) == 0) {
+            mgScore -= isolatedPawnPenalty;
+            egScore -= isolatedPawnPenalty;
+            TRACE(isolatedPawnPenalty, -1, -1);
+        } else if (square - 8 >= 0 && (pawnAttacks[black][square - 8] & board->bitboards[P]) &&
+                   (board->bitboards[p] & isolatedPawnMasks[square] & ~passedPawnMasks[black][square]) == 0) {
+            mgScore -= backwardPawnPenalty[0];
+            egScore -= backwardPawnPenalty[1];
+            TRACE(backwardPawnPenalty[0], -1, 0);
+            TRACE(backwardPawnPenalty[1], 0, -1);
+        }
+
+        if (((board->bitboards[P] | (board->bitboards[p] & fileMasks[square])) & passedPawnMasks[black][square]) == 0) {
+            int rank = mirrorSquare[square] / 8;
+            setBit(passed[black], square);
+            mgScore -= passedPawnBonus[0][rank];
+            egScore -= passedPawnBonus[1][rank];
+            TRACE(passedPawnBonus[0][rank], -1, 0);
+            TRACE(passedPawnBonus[1][rank], 0, -1);
+
+            U64 adjacentPassedFriendly = board->bitboards[p] & isolatedPawnMasks[square];
+            while (adjacentPassedFriendly) {
+                int adjSq = getLSBindex(adjacentPassedFriendly);
+                if (((board->bitboards[P] | (board->bitboards[p] & fileMasks[adjSq])) & passedPawnMasks[black][adjSq]) == 0) {
+                    mgScore -= connectedPassedBonus[0];
+                    egScore -= connectedPassedBonus[1];
+                    TRACE(connectedPassedBonus[0], -1, 0);
+                    TRACE(connectedPassedBonus[1], 0, -1);
+                    break;
+                }
+                popBit(adjacentPassedFriendly, adjSq);
+            }
+        }
+        popBit(bitboard, square);
+    }
+
+    entry->key = board->pawnHash;
+    entry->passedPawns[white] = passed[white];
+    entry->passedPawns[black] = passed[black];
+    entry->pawnAttacks[white] = pawnAttackMap[white];
+    entry->pawnAttacks[black] = pawnAttackMap[black];
+    entry->mgScore = mgScore;
+    entry->egScore = egScore;
+}
+
+// Without a table (tuner, one-off evaluations) the terms are computed into scratch.
+// A zeroed entry has key 0, which is also the correct entry for a pawnless board.
+static inline const PawnHashEntry *probePawnStructure(const Board *board, PawnHashTable *table, PawnHashEntry *scratch) {
+    if (table == NULL) {
+        evaluatePawnStructure(board, scratch);
+        return scratch;
+    }
+
+    PawnHashEntry *entry = &table->entries[board->pawnHash & (pawnHashEntries - 1)];
+    table->probes++;
+    if (entry->key == board->pawnHash) {
+        table->hits++;
+        return entry;
+    }
+    evaluatePawnStructure(board, entry);
+    return entry;
+}
+
+static inline int evaluate(Board *board, PawnHashTable *pawnTable = NULL) {
     int mgScore = 0;
     int egScore = 0;
     int score = 0;
 
-    int phase = 0;
-    int whitePhase = 0;
-    int blackPhase = 0;
-    int whiteMaterial = 0;
-    int blackMaterial = 0;
+#ifdef TUNING_MODE
+    // Parameters change between calls, so the sums are rebuilt from them every time
+    int pieceScores[2], phases[2], materials[2];
+    computePieceScores(board, pieceScores, phases, materials);
+#else
+    const int *pieceScores = board->psqtScore;
+    const int *phases = board->phase;
+    const int *materials = board->material;
+#endif
+    mgScore += pieceScores[MG];
+    egScore += pieceScores[EG];
+    int whitePhase = phases[white];
+    int blackPhase = phases[black];
+    int phase = whitePhase + blackPhase;
+    int whiteMaterial = materials[white];
+    int blackMaterial = materials[black];
     U64 bitboard;
     int square;
-    int numPawnsOnFile;
     int mobility;
 
     int whiteKingSq = getLSBindex(board->bitboards[K]);
@@ -440,112 +711,36 @@ static inline int evaluate(Board *board) {
     U64 whiteBishopAttacks = 0ULL, blackBishopAttacks = 0ULL;
     U64 whiteRookAttacks = 0ULL, blackRookAttacks = 0ULL;
 
-    U64 wp = board->bitboards[P];
-    while (wp) { int sq = getLSBindex(wp); whitePawnAttacks |= pawnAttacks[white][sq]; popBit(wp, sq); }
-    U64 bp = board->bitboards[p];
-    while (bp) { int sq = getLSBindex(bp); blackPawnAttacks |= pawnAttacks[black][sq]; popBit(bp, sq); }
+    PawnHashEntry pawnScratch;
+    const PawnHashEntry *pawnEntry = probePawnStructure(board, pawnTable, &pawnScratch);
+    mgScore += pawnEntry->mgScore;
+    egScore += pawnEntry->egScore;
+    whitePawnAttacks = pawnEntry->pawnAttacks[white];
+    blackPawnAttacks = pawnEntry->pawnAttacks[black];
     whiteAttacks |= whitePawnAttacks;
     blackAttacks |= blackPawnAttacks;
     whiteAttacks |= kingAttacks[whiteKingSq];
     blackAttacks |= kingAttacks[blackKingSq];
 
-    for (int piece = P; piece <= k; ++piece) {
+    // Material, piece-square tables and phase come from the running sums above, pawn
+    // terms from the pawn cache; this loop adds the terms that need the whole board
+    for (int piece = N; piece <= k; ++piece) {
+        if (piece == p) continue;
         bitboard = board->bitboards[piece];
         while (bitboard) {
             square = getLSBindex(bitboard);
 
-            // Add mg and eg piece values
-            mgScore += pieceValue[0][piece];
-            egScore += pieceValue[1][piece];
-
-            if (piece < 6)
-                whiteMaterial += pieceValue[EG][piece];
-            else
-                blackMaterial -= pieceValue[EG][piece];
-
-            phase += phaseScore[piece];
-            whitePhase += (piece < 6) ? phaseScore[piece] : 0;
-            blackPhase += (piece >= 6) ? phaseScore[piece] : 0;
-
             switch (piece) {
-                case P:
-                    mgScore += pawnSquareTable[0][square];
-                    egScore += pawnSquareTable[1][square];
-
-                    numPawnsOnFile = countBits(board->bitboards[P] & fileMasks[square]);
-                    if (numPawnsOnFile > 1) {
-                        for (int r = square / 8 - 1; r >= 0; --r) {
-                            if (board->bitboards[P] & (1ULL << (r * 8 + square % 8))) {
-                                mgScore += doublePawnPenalty;
-                                egScore += doublePawnPenalty;
-                                break;
-                            }
-                        }
-                    }
-
-                    {
-                        int pFile = square % 8;
-                        int pRank = square / 8;
-                        if (pFile < 7 && (board->bitboards[P] & (1ULL << (pRank * 8 + pFile + 1)))) {
-                            mgScore += pawnDuoBonus[0];
-                            egScore += pawnDuoBonus[1];
-                        }
-                    }
-
-                    if ((board->bitboards[P] & isolatedPawnMasks[square]) == 0) {
-                        mgScore += isolatedPawnPenalty;
-                        egScore += isolatedPawnPenalty;
-                    } else if (square + 8 < 64 && (pawnAttacks[white][square + 8] & board->bitboards[p]) &&
-                               (board->bitboards[P] & isolatedPawnMasks[square] & ~passedPawnMasks[white][square]) == 0) {
-                        mgScore += backwardPawnPenalty[0];
-                        egScore += backwardPawnPenalty[1];
-                    }
-
-                    if (((board->bitboards[p] | (board->bitboards[P] & fileMasks[square])) & passedPawnMasks[white][square]) == 0) {
-                        int rank = square / 8;
-                        mgScore += passedPawnBonus[0][rank];
-                        egScore += passedPawnBonus[1][rank];
-
-                        int friendlyKingSq = getLSBindex(board->bitboards[K]);
-                        int enemyKingSq = getLSBindex(board->bitboards[k]);
-                        int friendlyDist = std::abs(friendlyKingSq / 8 - rank) + std::abs(friendlyKingSq % 8 - square % 8);
-                        int enemyDist = std::abs(enemyKingSq / 8 - rank) + std::abs(enemyKingSq % 8 - square % 8);
-                        egScore += (7 - friendlyDist) * passedPawnFriendlyKingBonus;
-                        egScore += enemyDist * passedPawnEnemyKingPenalty;
-
-                        if (square + 8 < 64 && (board->occupancies[black] & (1ULL << (square + 8)))) {
-                            mgScore += blockedPasserPenalty[0];
-                            egScore += blockedPasserPenalty[1];
-                        } else if (rank >= 5 && square + 8 < 64 &&
-                                   !(board->occupancies[both] & (1ULL << (square + 8)))) {
-                            static const int freePasserBonus[] = {0, 0, 0, 0, 0, 20, 60, 0};
-                            int file = square % 8;
-                            int bonus = freePasserBonus[rank];
-                            if (file == 0 || file == 7) bonus /= 2;
-                            egScore += bonus;
-                        }
-
-                        U64 adjacentPassedFriendly = board->bitboards[P] & isolatedPawnMasks[square];
-                        while (adjacentPassedFriendly) {
-                            int adjSq = getLSBindex(adjacentPassedFriendly);
-                            if (((board->bitboards[p] | (board->bitboards[P] & fileMasks[adjSq])) & passedPawnMasks[white][adjSq]) == 0) {
-                                mgScore += connectedPassedBonus[0];
-                                egScore += connectedPassedBonus[1];
-                                break;
-                            }
-                            popBit(adjacentPassedFriendly, adjSq);
-                        }
-                    }
-                    break;
-
                 case N:
                     {
                         U64 attacks = knightAttacks[square];
                         whiteKnightAttacks |= attacks;
                         whiteAttacks |= attacks;
                         mobility = countBits(attacks & ~board->occupancies[white] & ~blackPawnAttacks);
-                        mgScore += knightSquareTable[0][square] + mobility * mobilityMG;
-                        egScore += knightSquareTable[1][square] + mobility * mobilityEG;
+                        mgScore += mobility * mobilityMG;
+                        egScore += mobility * mobilityEG;
+                        TRACE(mobilityMG, mobility, 0);
+                        TRACE(mobilityEG, 0, mobility);
 
                         if (attacks & blackKingZone) {
                             whiteKingAttackWeight += 2;
@@ -559,6 +754,8 @@ static inline int evaluate(Board *board) {
                         if (onOutpost && defendedByPawn && !canBeKicked) {
                             mgScore += knightOutpostBonus[0];
                             egScore += knightOutpostBonus[1];
+                            TRACE(knightOutpostBonus[0], 1, 0);
+                            TRACE(knightOutpostBonus[1], 0, 1);
                         }
                     }
                     break;
@@ -569,8 +766,10 @@ static inline int evaluate(Board *board) {
                         whiteBishopAttacks |= attacks;
                         whiteAttacks |= attacks;
                         mobility = countBits(attacks & ~board->occupancies[white] & ~blackPawnAttacks);
-                        mgScore += bishopSquareTable[0][square] + mobility * mobilityMG;
-                        egScore += bishopSquareTable[1][square] + mobility * mobilityEG;
+                        mgScore += mobility * mobilityMG;
+                        egScore += mobility * mobilityEG;
+                        TRACE(mobilityMG, mobility, 0);
+                        TRACE(mobilityEG, 0, mobility);
                         if (attacks & blackKingZone) {
                             whiteKingAttackWeight += 2;
                             whiteKingAttackerCount++;
@@ -579,6 +778,8 @@ static inline int evaluate(Board *board) {
                         int pawnsOnColor = countBits(board->bitboards[P] & sameColorSquares);
                         mgScore += pawnsOnColor * badBishopPenalty[0];
                         egScore += pawnsOnColor * badBishopPenalty[1];
+                        TRACE(badBishopPenalty[0], pawnsOnColor, 0);
+                        TRACE(badBishopPenalty[1], 0, pawnsOnColor);
                     }
                     break;
 
@@ -588,8 +789,10 @@ static inline int evaluate(Board *board) {
                         whiteRookAttacks |= attacks;
                         whiteAttacks |= attacks;
                         mobility = countBits(attacks & ~board->occupancies[white] & ~blackPawnAttacks);
-                        mgScore += rookSquareTable[0][square] + mobility * mobilityMG;
-                        egScore += rookSquareTable[1][square] + mobility * mobilityEG;
+                        mgScore += mobility * mobilityMG;
+                        egScore += mobility * mobilityEG;
+                        TRACE(mobilityMG, mobility, 0);
+                        TRACE(mobilityEG, 0, mobility);
                         if (attacks & blackKingZone) {
                             whiteKingAttackWeight += 3;
                             whiteKingAttackerCount++;
@@ -599,10 +802,12 @@ static inline int evaluate(Board *board) {
                     if ((board->bitboards[P] & fileMasks[square]) == 0) {
                         mgScore += semiOpenFileBonus;
                         egScore += semiOpenFileBonus;
+                        TRACE(semiOpenFileBonus, 1, 1);
                     } 
                     if (((board->bitboards[p] | board->bitboards[P]) & fileMasks[square]) == 0) {
                         mgScore += openFileBonus;
                         egScore += openFileBonus;
+                        TRACE(openFileBonus, 1, 1);
                     }
 
                     if (square / 8 == 6) {
@@ -610,6 +815,8 @@ static inline int evaluate(Board *board) {
                         if (enemyKingRank == 7 || (board->bitboards[p] & rankMasks[48])) {
                             mgScore += rookOn7thBonus[0];
                             egScore += rookOn7thBonus[1];
+                            TRACE(rookOn7thBonus[0], 1, 0);
+                            TRACE(rookOn7thBonus[1], 0, 1);
                         }
                     }
 
@@ -620,8 +827,10 @@ static inline int evaluate(Board *board) {
                         U64 attacks = getQueenAttacks(square, board->occupancies[both]);
                         whiteAttacks |= attacks;
                         mobility = countBits(attacks & ~board->occupancies[white] & ~blackPawnAttacks);
-                        mgScore += queenSquareTable[0][square] + mobility * mobilityMG;
-                        egScore += queenSquareTable[1][square] + mobility * mobilityEG;
+                        mgScore += mobility * mobilityMG;
+                        egScore += mobility * mobilityEG;
+                        TRACE(mobilityMG, mobility, 0);
+                        TRACE(mobilityEG, 0, mobility);
                         if (attacks & blackKingZone) {
                             whiteKingAttackWeight += 5;
                             whiteKingAttackerCount++;
@@ -630,88 +839,20 @@ static inline int evaluate(Board *board) {
                     break;
 
                 case K:
-                    mgScore += kingSquareTable[0][square];
-                    egScore += kingSquareTable[1][square];
-
-                    if ((board->bitboards[P] & fileMasks[square]) == 0)
+                    if ((board->bitboards[P] & fileMasks[square]) == 0) {
                         mgScore -= semiOpenFileBonus;
-                    if (((board->bitboards[p] | board->bitboards[P]) & fileMasks[square]) == 0)
+                        TRACE(semiOpenFileBonus, -1, 0);
+                    }
+                    if (((board->bitboards[p] | board->bitboards[P]) & fileMasks[square]) == 0) {
                         mgScore -= openFileBonus;
+                        TRACE(openFileBonus, -1, 0);
+                    }
 
                     {
                         int pawnsShielding = countBits(board->bitboards[P] & kingAttacks[square]);
                         int expectedShield = (square % 8 == 0 || square % 8 == 7) ? 2 : 3;
                         mgScore += (expectedShield - pawnsShielding) * pawnShieldMissingPenalty;
-                    }
-                    break;
-
-                case p:
-                    mgScore -= pawnSquareTable[0][mirrorSquare[square]];
-                    egScore -= pawnSquareTable[1][mirrorSquare[square]];
-
-                    numPawnsOnFile = countBits(board->bitboards[p] & fileMasks[square]);
-                    if (numPawnsOnFile > 1) {
-                        for (int r = square / 8 + 1; r < 8; ++r) {
-                            if (board->bitboards[p] & (1ULL << (r * 8 + square % 8))) {
-                                mgScore -= doublePawnPenalty;
-                                egScore -= doublePawnPenalty;
-                                break;
-                            }
-                        }
-                    }
-
-                    {
-                        int pFile = square % 8;
-                        int pRank = square / 8;
-                        if (pFile < 7 && (board->bitboards[p] & (1ULL << (pRank * 8 + pFile + 1)))) {
-                            mgScore -= pawnDuoBonus[0];
-                            egScore -= pawnDuoBonus[1];
-                        }
-                    }
-
-                    if ((board->bitboards[p] & isolatedPawnMasks[square]) == 0) {
-                        mgScore -= isolatedPawnPenalty;
-                        egScore -= isolatedPawnPenalty;
-                    } else if (square - 8 >= 0 && (pawnAttacks[black][square - 8] & board->bitboards[P]) &&
-                               (board->bitboards[p] & isolatedPawnMasks[square] & ~passedPawnMasks[black][square]) == 0) {
-                        mgScore -= backwardPawnPenalty[0];
-                        egScore -= backwardPawnPenalty[1];
-                    }
-
-                    if (((board->bitboards[P] | (board->bitboards[p] & fileMasks[square])) & passedPawnMasks[black][square]) == 0) {
-                        int rank = mirrorSquare[square] / 8;
-                        mgScore -= passedPawnBonus[0][rank];
-                        egScore -= passedPawnBonus[1][rank];
-
-                        int friendlyKingSq = getLSBindex(board->bitboards[k]);
-                        int enemyKingSq = getLSBindex(board->bitboards[K]);
-                        int friendlyDist = std::abs(friendlyKingSq / 8 - (square / 8)) + std::abs(friendlyKingSq % 8 - square % 8);
-                        int enemyDist = std::abs(enemyKingSq / 8 - (square / 8)) + std::abs(enemyKingSq % 8 - square % 8);
-                        egScore -= (7 - friendlyDist) * passedPawnFriendlyKingBonus;
-                        egScore -= enemyDist * passedPawnEnemyKingPenalty;
-
-                        if (square - 8 >= 0 && (board->occupancies[white] & (1ULL << (square - 8)))) {
-                            mgScore -= blockedPasserPenalty[0];
-                            egScore -= blockedPasserPenalty[1];
-                        } else if (rank >= 5 && square - 8 >= 0 &&
-                                   !(board->occupancies[both] & (1ULL << (square - 8)))) {
-                            static const int freePasserBonus[] = {0, 0, 0, 0, 0, 20, 60, 0};
-                            int file = square % 8;
-                            int bonus = freePasserBonus[rank];
-                            if (file == 0 || file == 7) bonus /= 2;
-                            egScore -= bonus;
-                        }
-
-                        U64 adjacentPassedFriendly = board->bitboards[p] & isolatedPawnMasks[square];
-                        while (adjacentPassedFriendly) {
-                            int adjSq = getLSBindex(adjacentPassedFriendly);
-                            if (((board->bitboards[P] | (board->bitboards[p] & fileMasks[adjSq])) & passedPawnMasks[black][adjSq]) == 0) {
-                                mgScore -= connectedPassedBonus[0];
-                                egScore -= connectedPassedBonus[1];
-                                break;
-                            }
-                            popBit(adjacentPassedFriendly, adjSq);
-                        }
+                        TRACE(pawnShieldMissingPenalty, (expectedShield - pawnsShielding), 0);
                     }
                     break;
 
@@ -721,8 +862,10 @@ static inline int evaluate(Board *board) {
                         blackKnightAttacks |= attacks;
                         blackAttacks |= attacks;
                         mobility = countBits(attacks & ~board->occupancies[black] & ~whitePawnAttacks);
-                        mgScore -= (knightSquareTable[0][mirrorSquare[square]] + mobility * mobilityMG);
-                        egScore -= (knightSquareTable[1][mirrorSquare[square]] + mobility * mobilityEG);
+                        mgScore -= mobility * mobilityMG;
+                        egScore -= mobility * mobilityEG;
+                        TRACE(mobilityMG, -mobility, 0);
+                        TRACE(mobilityEG, 0, -mobility);
 
                         if (attacks & whiteKingZone) {
                             blackKingAttackWeight += 2;
@@ -736,6 +879,8 @@ static inline int evaluate(Board *board) {
                         if (onOutpost && defendedByPawn && !canBeKicked) {
                             mgScore -= knightOutpostBonus[0];
                             egScore -= knightOutpostBonus[1];
+                            TRACE(knightOutpostBonus[0], -1, 0);
+                            TRACE(knightOutpostBonus[1], 0, -1);
                         }
                     }
                     break;
@@ -746,8 +891,10 @@ static inline int evaluate(Board *board) {
                         blackBishopAttacks |= attacks;
                         blackAttacks |= attacks;
                         mobility = countBits(attacks & ~board->occupancies[black] & ~whitePawnAttacks);
-                        mgScore -= (bishopSquareTable[0][mirrorSquare[square]] + mobility * mobilityMG);
-                        egScore -= (bishopSquareTable[1][mirrorSquare[square]] + mobility * mobilityEG);
+                        mgScore -= mobility * mobilityMG;
+                        egScore -= mobility * mobilityEG;
+                        TRACE(mobilityMG, -mobility, 0);
+                        TRACE(mobilityEG, 0, -mobility);
                         if (attacks & whiteKingZone) {
                             blackKingAttackWeight += 2;
                             blackKingAttackerCount++;
@@ -756,6 +903,8 @@ static inline int evaluate(Board *board) {
                         int pawnsOnColor = countBits(board->bitboards[p] & sameColorSquares);
                         mgScore -= pawnsOnColor * badBishopPenalty[0];
                         egScore -= pawnsOnColor * badBishopPenalty[1];
+                        TRACE(badBishopPenalty[0], -pawnsOnColor, 0);
+                        TRACE(badBishopPenalty[1], 0, -pawnsOnColor);
                     }
                     break;
 
@@ -765,8 +914,10 @@ static inline int evaluate(Board *board) {
                         blackRookAttacks |= attacks;
                         blackAttacks |= attacks;
                         mobility = countBits(attacks & ~board->occupancies[black] & ~whitePawnAttacks);
-                        mgScore -= (rookSquareTable[0][mirrorSquare[square]] + mobility * mobilityMG);
-                        egScore -= (rookSquareTable[1][mirrorSquare[square]] + mobility * mobilityEG);
+                        mgScore -= mobility * mobilityMG;
+                        egScore -= mobility * mobilityEG;
+                        TRACE(mobilityMG, -mobility, 0);
+                        TRACE(mobilityEG, 0, -mobility);
                         if (attacks & whiteKingZone) {
                             blackKingAttackWeight += 3;
                             blackKingAttackerCount++;
@@ -776,10 +927,12 @@ static inline int evaluate(Board *board) {
                     if ((board->bitboards[p] & fileMasks[square]) == 0) {
                         mgScore -= semiOpenFileBonus;
                         egScore -= semiOpenFileBonus;
+                        TRACE(semiOpenFileBonus, -1, -1);
                     } 
                     if (((board->bitboards[p] | board->bitboards[P]) & fileMasks[square]) == 0) {
                         mgScore -= openFileBonus;
                         egScore -= openFileBonus;
+                        TRACE(openFileBonus, -1, -1);
                     }
 
                     if (square / 8 == 1) {
@@ -787,6 +940,8 @@ static inline int evaluate(Board *board) {
                         if (enemyKingRank == 0 || (board->bitboards[P] & rankMasks[8])) {
                             mgScore -= rookOn7thBonus[0];
                             egScore -= rookOn7thBonus[1];
+                            TRACE(rookOn7thBonus[0], -1, 0);
+                            TRACE(rookOn7thBonus[1], 0, -1);
                         }
                     }
 
@@ -797,8 +952,10 @@ static inline int evaluate(Board *board) {
                         U64 attacks = getQueenAttacks(square, board->occupancies[both]);
                         blackAttacks |= attacks;
                         mobility = countBits(attacks & ~board->occupancies[black] & ~whitePawnAttacks);
-                        mgScore -= (queenSquareTable[0][mirrorSquare[square]] + mobility * mobilityMG);
-                        egScore -= (queenSquareTable[1][mirrorSquare[square]] + mobility * mobilityEG);
+                        mgScore -= mobility * mobilityMG;
+                        egScore -= mobility * mobilityEG;
+                        TRACE(mobilityMG, -mobility, 0);
+                        TRACE(mobilityEG, 0, -mobility);
                         if (attacks & whiteKingZone) {
                             blackKingAttackWeight += 5;
                             blackKingAttackerCount++;
@@ -807,18 +964,20 @@ static inline int evaluate(Board *board) {
                     break;
 
                 case k:
-                    mgScore -= kingSquareTable[0][mirrorSquare[square]];
-                    egScore -= kingSquareTable[1][mirrorSquare[square]];
-
-                    if ((board->bitboards[p] & fileMasks[square]) == 0)
+                    if ((board->bitboards[p] & fileMasks[square]) == 0) {
                         mgScore += semiOpenFileBonus;
-                    if (((board->bitboards[p] | board->bitboards[P]) & fileMasks[square]) == 0)
+                        TRACE(semiOpenFileBonus, 1, 0);
+                    }
+                    if (((board->bitboards[p] | board->bitboards[P]) & fileMasks[square]) == 0) {
                         mgScore += openFileBonus;
+                        TRACE(openFileBonus, 1, 0);
+                    }
 
                     {
                         int pawnsShielding = countBits(board->bitboards[p] & kingAttacks[square]);
                         int expectedShield = (square % 8 == 0 || square % 8 == 7) ? 2 : 3;
                         mgScore -= (expectedShield - pawnsShielding) * pawnShieldMissingPenalty;
+                        TRACE(pawnShieldMissingPenalty, -(expectedShield - pawnsShielding), 0);
                     }
                     break;
             }
@@ -826,22 +985,85 @@ static inline int evaluate(Board *board) {
         }
     }
 
+    // Passed pawn terms that also depend on the kings and the other pieces
+    U64 passers = pawnEntry->passedPawns[white];
+    while (passers) {
+        square = getLSBindex(passers);
+        int rank = square / 8;
+
+        int friendlyDist = std::abs(whiteKingSq / 8 - rank) + std::abs(whiteKingSq % 8 - square % 8);
+        int enemyDist = std::abs(blackKingSq / 8 - rank) + std::abs(blackKingSq % 8 - square % 8);
+        egScore += (7 - friendlyDist) * passedPawnFriendlyKingBonus;
+        TRACE(passedPawnFriendlyKingBonus, 0, (7 - friendlyDist));
+        egScore += enemyDist * passedPawnEnemyKingPenalty;
+        TRACE(passedPawnEnemyKingPenalty, 0, enemyDist);
+
+        if (square + 8 < 64 && (board->occupancies[black] & (1ULL << (square + 8)))) {
+            mgScore += blockedPasserPenalty[0];
+            egScore += blockedPasserPenalty[1];
+            TRACE(blockedPasserPenalty[0], 1, 0);
+            TRACE(blockedPasserPenalty[1], 0, 1);
+        } else if (rank >= 5 && square + 8 < 64 &&
+                   !(board->occupancies[both] & (1ULL << (square + 8)))) {
+            static const int freePasserBonus[] = {0, 0, 0, 0, 0, 20, 60, 0};
+            int file = square % 8;
+            int bonus = freePasserBonus[rank];
+            if (file == 0 || file == 7) bonus /= 2;
+            egScore += bonus;
+        }
+        popBit(passers, square);
+    }
+
+    passers = pawnEntry->passedPawns[black];
+    while (passers) {
+        square = getLSBindex(passers);
+        int rank = mirrorSquare[square] / 8;
+
+        int friendlyDist = std::abs(blackKingSq / 8 - (square / 8)) + std::abs(blackKingSq % 8 - square % 8);
+        int enemyDist = std::abs(whiteKingSq / 8 - (square / 8)) + std::abs(whiteKingSq % 8 - square % 8);
+        egScore -= (7 - friendlyDist) * passedPawnFriendlyKingBonus;
+        TRACE(passedPawnFriendlyKingBonus, 0, -(7 - friendlyDist));
+        egScore -= enemyDist * passedPawnEnemyKingPenalty;
+        TRACE(passedPawnEnemyKingPenalty, 0, -enemyDist);
+
+        if (square - 8 >= 0 && (board->occupancies[white] & (1ULL << (square - 8)))) {
+            mgScore -= blockedPasserPenalty[0];
+            egScore -= blockedPasserPenalty[1];
+            TRACE(blockedPasserPenalty[0], -1, 0);
+            TRACE(blockedPasserPenalty[1], 0, -1);
+        } else if (rank >= 5 && square - 8 >= 0 &&
+                   !(board->occupancies[both] & (1ULL << (square - 8)))) {
+            static const int freePasserBonus[] = {0, 0, 0, 0, 0, 20, 60, 0};
+            int file = square % 8;
+            int bonus = freePasserBonus[rank];
+            if (file == 0 || file == 7) bonus /= 2;
+            egScore -= bonus;
+        }
+        popBit(passers, square);
+    }
+
     if (countBits(board->bitboards[B]) >= 2) {
         mgScore += bishopPairBonus[0];
         egScore += bishopPairBonus[1];
+        TRACE(bishopPairBonus[0], 1, 0);
+        TRACE(bishopPairBonus[1], 0, 1);
     }
     if (countBits(board->bitboards[b]) >= 2) {
         mgScore -= bishopPairBonus[0];
         egScore -= bishopPairBonus[1];
+        TRACE(bishopPairBonus[0], -1, 0);
+        TRACE(bishopPairBonus[1], 0, -1);
     }
 
     if (whiteKingAttackerCount >= 2) {
         int idx = std::min(whiteKingAttackWeight, 29);
         mgScore += kingSafetyTable[idx];
+        TRACE(kingSafetyTable[idx], 1, 0);
     }
     if (blackKingAttackerCount >= 2) {
         int idx = std::min(blackKingAttackWeight, 29);
         mgScore -= kingSafetyTable[idx];
+        TRACE(kingSafetyTable[idx], -1, 0);
     }
 
     // --- Threats: hanging pieces and minor/rook threats ---
@@ -856,28 +1078,40 @@ static inline int evaluate(Board *board) {
         int threatCountW = countBits(minorThreatsW);
         mgScore += threatCountW * threatByMinor[0];
         egScore += threatCountW * threatByMinor[1];
+        TRACE(threatByMinor[0], threatCountW, 0);
+        TRACE(threatByMinor[1], 0, threatCountW);
 
         U64 rookThreatsW = whiteRookAttacks & board->bitboards[q];
         int rookThreatCountW = countBits(rookThreatsW);
         mgScore += rookThreatCountW * threatByRook[0];
         egScore += rookThreatCountW * threatByRook[1];
+        TRACE(threatByRook[0], rookThreatCountW, 0);
+        TRACE(threatByRook[1], 0, rookThreatCountW);
 
         U64 minorThreatsB = blackMinorAttacks & (board->bitboards[R] | board->bitboards[Q]);
         int threatCountB = countBits(minorThreatsB);
         mgScore -= threatCountB * threatByMinor[0];
         egScore -= threatCountB * threatByMinor[1];
+        TRACE(threatByMinor[0], -threatCountB, 0);
+        TRACE(threatByMinor[1], 0, -threatCountB);
 
         U64 rookThreatsB = blackRookAttacks & board->bitboards[Q];
         int rookThreatCountB = countBits(rookThreatsB);
         mgScore -= rookThreatCountB * threatByRook[0];
         egScore -= rookThreatCountB * threatByRook[1];
+        TRACE(threatByRook[0], -rookThreatCountB, 0);
+        TRACE(threatByRook[1], 0, -rookThreatCountB);
 
         U64 whiteHanging = whitePieces & blackAttacks & ~whiteAttacks;
         U64 blackHanging = blackPieces & whiteAttacks & ~blackAttacks;
         mgScore += countBits(whiteHanging) * hangingPenalty[0];
         egScore += countBits(whiteHanging) * hangingPenalty[1];
+        TRACE(hangingPenalty[0], countBits(whiteHanging), 0);
+        TRACE(hangingPenalty[1], 0, countBits(whiteHanging));
         mgScore -= countBits(blackHanging) * hangingPenalty[0];
         egScore -= countBits(blackHanging) * hangingPenalty[1];
+        TRACE(hangingPenalty[0], -(countBits(blackHanging)), 0);
+        TRACE(hangingPenalty[1], 0, -(countBits(blackHanging)));
 
         // Pawn push threats: pawns that can advance to attack enemy pieces
         U64 whitePawnPush = ((board->bitboards[P] << 8) & ~board->occupancies[both]);
@@ -885,12 +1119,14 @@ static inline int evaluate(Board *board) {
                                (((whitePawnPush & ~0xFF00000000000000ULL) << 9) & ~fileMasks[0]);
         U64 whitePushThreats = whitePushAttacks & blackPieces & ~blackPawnAttacks;
         mgScore += countBits(whitePushThreats) * pawnPushThreat;
+        TRACE(pawnPushThreat, countBits(whitePushThreats), 0);
 
         U64 blackPawnPush = ((board->bitboards[p] >> 8) & ~board->occupancies[both]);
         U64 blackPushAttacks = (((blackPawnPush & ~0x00000000000000FFULL) >> 7) & ~fileMasks[0]) |
                                (((blackPawnPush & ~0x00000000000000FFULL) >> 9) & ~fileMasks[7]);
         U64 blackPushThreats = blackPushAttacks & whitePieces & ~whitePawnAttacks;
         mgScore -= countBits(blackPushThreats) * pawnPushThreat;
+        TRACE(pawnPushThreat, -(countBits(blackPushThreats)), 0);
     }
 
     // --- Space evaluation (MG only) ---
@@ -904,6 +1140,7 @@ static inline int evaluate(Board *board) {
         int whiteSpace = countBits(whiteSafe & (whiteAttacks | ~blackAttacks));
         int blackSpace = countBits(blackSafe & (blackAttacks | ~whiteAttacks));
         mgScore += (whiteSpace - blackSpace) * spaceBonus;
+        TRACE(spaceBonus, (whiteSpace - blackSpace), 0);
     }
 
     // --- Pawn storm on enemy king ---
@@ -916,6 +1153,7 @@ static inline int evaluate(Board *board) {
             int rank = sq / 8;
             if (std::abs(file - bkFile) <= 1) {
                 mgScore += pawnStormBonus[rank];
+                TRACE(pawnStormBonus[rank], 1, 0);
             }
             popBit(stormPawns, sq);
         }
@@ -928,6 +1166,7 @@ static inline int evaluate(Board *board) {
             int rank = 7 - sq / 8;
             if (std::abs(file - wkFile) <= 1) {
                 mgScore -= pawnStormBonus[rank];
+                TRACE(pawnStormBonus[rank], -1, 0);
             }
             popBit(stormPawns, sq);
         }
@@ -940,6 +1179,8 @@ static inline int evaluate(Board *board) {
         int blackCenterCtrl = countBits(blackAttacks & CENTER);
         mgScore += (whiteCenterCtrl - blackCenterCtrl) * centerControlBonus[0];
         egScore += (whiteCenterCtrl - blackCenterCtrl) * centerControlBonus[1];
+        TRACE(centerControlBonus[0], (whiteCenterCtrl - blackCenterCtrl), 0);
+        TRACE(centerControlBonus[1], 0, (whiteCenterCtrl - blackCenterCtrl));
     }
 
     // --- Connected rooks (using cached rook attacks) ---
@@ -950,6 +1191,8 @@ static inline int evaluate(Board *board) {
             if (whiteRookAttacks & (1ULL << r2)) {
                 mgScore += connectedRookBonus[0];
                 egScore += connectedRookBonus[1];
+                TRACE(connectedRookBonus[0], 1, 0);
+                TRACE(connectedRookBonus[1], 0, 1);
             }
         }
         U64 blackRooks = board->bitboards[r];
@@ -958,6 +1201,8 @@ static inline int evaluate(Board *board) {
             if (blackRookAttacks & (1ULL << r2)) {
                 mgScore -= connectedRookBonus[0];
                 egScore -= connectedRookBonus[1];
+                TRACE(connectedRookBonus[0], -1, 0);
+                TRACE(connectedRookBonus[1], 0, -1);
             }
         }
     }
@@ -970,6 +1215,7 @@ static inline int evaluate(Board *board) {
             U64 adjFileMask = fileMasks[f];
             if (((board->bitboards[P] | board->bitboards[p]) & adjFileMask) == 0) {
                 mgScore += kingAdjacentOpenFile;
+                TRACE(kingAdjacentOpenFile, 1, 0);
             }
         }
         int bkFile = blackKingSq % 8;
@@ -978,11 +1224,15 @@ static inline int evaluate(Board *board) {
             U64 adjFileMask = fileMasks[f];
             if (((board->bitboards[P] | board->bitboards[p]) & adjFileMask) == 0) {
                 mgScore -= kingAdjacentOpenFile;
+                TRACE(kingAdjacentOpenFile, -1, 0);
             }
         }
     }
 
     if (phase <= 3 && insufficientMaterial(board)) {
+#ifdef TUNING_MODE
+        if (evalTrace) evalTrace->drawn = true;
+#endif
         return 0; // Draw by insufficient material
     }
 
@@ -1001,6 +1251,14 @@ static inline int evaluate(Board *board) {
         score = score * scaleFactor / 100;
 
     score += (board->sideToMove == white) ? tempoBonus : -tempoBonus;
+#ifdef TUNING_MODE
+    if (evalTrace) {
+        evalTrace->phase = phase;
+        evalTrace->scale = scaleFactor;
+        evalTrace->tempo = (board->sideToMove == white) ? 1 : -1;
+        evalTrace->drawn = false;
+    }
+#endif
     return board->sideToMove == white ? score : -score;
 }
 
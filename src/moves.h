@@ -44,6 +44,18 @@ static inline int isSquareAttacked(const Board *board, int square, int side) {
     return 0;
 }
 
+// Attackers of both colours to a square for a given occupancy
+static inline U64 getAttackersToSquare(const Board *board, int square, U64 occ) {
+    U64 attackers = 0ULL;
+    attackers |= pawnAttacks[black][square] & board->bitboards[P];
+    attackers |= pawnAttacks[white][square] & board->bitboards[p];
+    attackers |= knightAttacks[square] & (board->bitboards[N] | board->bitboards[n]);
+    attackers |= getBishopAttacks(square, occ) & (board->bitboards[B] | board->bitboards[b] | board->bitboards[Q] | board->bitboards[q]);
+    attackers |= getRookAttacks(square, occ) & (board->bitboards[R] | board->bitboards[r] | board->bitboards[Q] | board->bitboards[q]);
+    attackers |= kingAttacks[square] & (board->bitboards[K] | board->bitboards[k]);
+    return attackers & occ;
+}
+
 static inline void printAttackedSquares(const Board *board, int side) {
     std::cout << "Attacked squares by " << (side == white ? "White" : "Black") << ":\n";
     U64 attacked = 0ULL;
@@ -498,6 +510,405 @@ static inline void generateCaptures(Board *board, MoveList *moves) {
     }
 }
 
+static inline void generateQuiets(Board *board, MoveList *moves) {
+    moves->count = 0;
+    int source, target;
+    U64 bitboard, attacks;
+
+    int us = board->sideToMove;
+    U64 emptySquares = board->occupancies[3];
+    int knightPiece = us == white ? N : n;
+    int bishopPiece = us == white ? B : b;
+    int rookPiece = us == white ? R : r;
+    int queenPiece = us == white ? Q : q;
+    int kingPiece = us == white ? K : k;
+
+    // Knight quiets
+    bitboard = board->bitboards[knightPiece];
+    while (bitboard) {
+        source = getLSBindex(bitboard);
+        attacks = knightAttacks[source] & emptySquares;
+        while (attacks) {
+            target = getLSBindex(attacks);
+            addMove(moves, encodeMove(source, target, knightPiece, 0, 0, 0, 0, 0));
+            popBit(attacks, target);
+        }
+        popBit(bitboard, source);
+    }
+
+    // Bishop quiets
+    bitboard = board->bitboards[bishopPiece];
+    while (bitboard) {
+        source = getLSBindex(bitboard);
+        attacks = getBishopAttacks(source, board->occupancies[both]) & emptySquares;
+        while (attacks) {
+            target = getLSBindex(attacks);
+            addMove(moves, encodeMove(source, target, bishopPiece, 0, 0, 0, 0, 0));
+            popBit(attacks, target);
+        }
+        popBit(bitboard, source);
+    }
+
+    // Rook quiets
+    bitboard = board->bitboards[rookPiece];
+    while (bitboard) {
+        source = getLSBindex(bitboard);
+        attacks = getRookAttacks(source, board->occupancies[both]) & emptySquares;
+        while (attacks) {
+            target = getLSBindex(attacks);
+            addMove(moves, encodeMove(source, target, rookPiece, 0, 0, 0, 0, 0));
+            popBit(attacks, target);
+        }
+        popBit(bitboard, source);
+    }
+
+    // Queen quiets
+    bitboard = board->bitboards[queenPiece];
+    while (bitboard) {
+        source = getLSBindex(bitboard);
+        attacks = getQueenAttacks(source, board->occupancies[both]) & emptySquares;
+        while (attacks) {
+            target = getLSBindex(attacks);
+            addMove(moves, encodeMove(source, target, queenPiece, 0, 0, 0, 0, 0));
+            popBit(attacks, target);
+        }
+        popBit(bitboard, source);
+    }
+
+    // Pawn pushes (promotions are produced by generateCaptures)
+    if (board->sideToMove == white) {
+        U64 singlePush = (board->bitboards[P] << 8) & emptySquares;
+        U64 doublePush = ((singlePush & RANK_3) << 8) & emptySquares;
+        singlePush &= ~RANK_8;
+        while (singlePush) {
+            target = getLSBindex(singlePush);
+            addMove(moves, encodeMove(target - 8, target, P, 0, 0, 0, 0, 0));
+            popBit(singlePush, target);
+        }
+        while (doublePush) {
+            target = getLSBindex(doublePush);
+            addMove(moves, encodeMove(target - 16, target, P, 0, 0, 1, 0, 0));
+            popBit(doublePush, target);
+        }
+    } else {
+        U64 singlePush = (board->bitboards[p] >> 8) & emptySquares;
+        U64 doublePush = ((singlePush & RANK_6) >> 8) & emptySquares;
+        singlePush &= ~RANK_1;
+        while (singlePush) {
+            target = getLSBindex(singlePush);
+            addMove(moves, encodeMove(target + 8, target, p, 0, 0, 0, 0, 0));
+            popBit(singlePush, target);
+        }
+        while (doublePush) {
+            target = getLSBindex(doublePush);
+            addMove(moves, encodeMove(target + 16, target, p, 0, 0, 1, 0, 0));
+            popBit(doublePush, target);
+        }
+    }
+
+    // Castle Moves
+    if (board->sideToMove == white) {
+        if ((board->castlingRights & wk) && !getBit(board->occupancies[both], f1) && !getBit(board->occupancies[both], g1) &&
+            !isSquareAttacked(board, e1, black) && !isSquareAttacked(board, f1, black))
+            addMove(moves, encodeMove(e1, g1, K, 0, 0, 0, 0, 1)); // O-O
+        if ((board->castlingRights & wq) && !getBit(board->occupancies[both], d1) && !getBit(board->occupancies[both], c1) &&
+            !getBit(board->occupancies[both], b1) && !isSquareAttacked(board, e1, black) && !isSquareAttacked(board, d1, black))
+            addMove(moves, encodeMove(e1, c1, K, 0, 0, 0, 0, 1)); // O-O-O
+    } else {
+        if ((board->castlingRights & bk) && !getBit(board->occupancies[both], f8) && !getBit(board->occupancies[both], g8) &&
+            !isSquareAttacked(board, e8, white) && !isSquareAttacked(board, f8, white))
+            addMove(moves, encodeMove(e8, g8, k, 0, 0, 0, 0, 1)); // O-O
+        if ((board->castlingRights & bq) && !getBit(board->occupancies[both], d8) && !getBit(board->occupancies[both], c8) &&
+            !getBit(board->occupancies[both], b8) && !isSquareAttacked(board, e8, white) && !isSquareAttacked(board, d8, white))
+            addMove(moves, encodeMove(e8, c8, k, 0, 0, 0, 0, 1)); // O-O-O
+    }
+
+    // King quiets
+    source = getLSBindex(board->bitboards[kingPiece]);
+    attacks = kingAttacks[source] & emptySquares;
+    while (attacks) {
+        target = getLSBindex(attacks);
+        addMove(moves, encodeMove(source, target, kingPiece, 0, 0, 0, 0, 0));
+        popBit(attacks, target);
+    }
+}
+
+// Rebuilds the full move from a 16-bit TT move (source, target, promoted) if that move
+// is pseudo-legal in this position, otherwise returns 0. Lets the search try hash,
+// killer and counter moves without generating the whole move list first.
+static inline int ttMoveToMove(const Board *board, uint16_t ttMove) {
+    if (ttMove == 0) return 0;
+
+    int source = ttMove & 0x3F;
+    int target = (ttMove >> 6) & 0x3F;
+    int promoted = (ttMove >> 12) & 0xF;
+
+    int us = board->sideToMove;
+    U64 targetBit = 1ULL << target;
+    if (!getBit(board->occupancies[us], source) || (board->occupancies[us] & targetBit))
+        return 0;
+
+    int piece = board->pieceOn[source];
+    int firstPiece = (us == white) ? P : p;
+    int capture = (board->occupancies[us ^ 1] & targetBit) ? 1 : 0;
+
+    if (piece == firstPiece) {
+        int forward = (us == white) ? 8 : -8;
+        bool promoting = targetBit & ((us == white) ? RANK_8 : RANK_1);
+        if (promoting) {
+            if (promoted < firstPiece + 1 || promoted > firstPiece + 4) return 0;
+        } else if (promoted) {
+            return 0;
+        }
+
+        if (target == source + forward)
+            return capture ? 0 : encodeMove(source, target, piece, promoted, 0, 0, 0, 0);
+
+        if (target == source + 2 * forward) {
+            U64 startRank = (us == white) ? RANK_2 : RANK_7;
+            if (!((1ULL << source) & startRank) || getBit(board->occupancies[both], source + forward) || capture)
+                return 0;
+            return encodeMove(source, target, piece, 0, 0, 1, 0, 0);
+        }
+
+        if (pawnAttacks[us][source] & targetBit) {
+            if (capture)
+                return encodeMove(source, target, piece, promoted, 1, 0, 0, 0);
+            if (target == board->enPassantSquare)
+                return encodeMove(source, target, piece, 0, 1, 0, 1, 0);
+        }
+        return 0;
+    }
+
+    if (promoted) return 0;
+
+    U64 attacks = 0ULL;
+    switch (piece - firstPiece) {
+        case N: attacks = knightAttacks[source]; break;
+        case B: attacks = getBishopAttacks(source, board->occupancies[both]); break;
+        case R: attacks = getRookAttacks(source, board->occupancies[both]); break;
+        case Q: attacks = getQueenAttacks(source, board->occupancies[both]); break;
+        case K:
+            if (std::abs(target - source) == 2) {
+                int them = us ^ 1;
+                U64 occ = board->occupancies[both];
+                if (us == white && source == e1 && target == g1 && (board->castlingRights & wk) &&
+                    !getBit(occ, f1) && !getBit(occ, g1) && !isSquareAttacked(board, e1, them) && !isSquareAttacked(board, f1, them))
+                    return encodeMove(e1, g1, K, 0, 0, 0, 0, 1);
+                if (us == white && source == e1 && target == c1 && (board->castlingRights & wq) &&
+                    !getBit(occ, d1) && !getBit(occ, c1) && !getBit(occ, b1) && !isSquareAttacked(board, e1, them) && !isSquareAttacked(board, d1, them))
+                    return encodeMove(e1, c1, K, 0, 0, 0, 0, 1);
+                if (us == black && source == e8 && target == g8 && (board->castlingRights & bk) &&
+                    !getBit(occ, f8) && !getBit(occ, g8) && !isSquareAttacked(board, e8, them) && !isSquareAttacked(board, f8, them))
+                    return encodeMove(e8, g8, k, 0, 0, 0, 0, 1);
+                if (us == black && source == e8 && target == c8 && (board->castlingRights & bq) &&
+                    !getBit(occ, d8) && !getBit(occ, c8) && !getBit(occ, b8) && !isSquareAttacked(board, e8, them) && !isSquareAttacked(board, d8, them))
+                    return encodeMove(e8, c8, k, 0, 0, 0, 0, 1);
+                return 0;
+            }
+            attacks = kingAttacks[source];
+            break;
+    }
+
+    if (!(attacks & targetBit)) return 0;
+    return encodeMove(source, target, piece, 0, capture, 0, 0, 0);
+}
+
+static inline bool isPseudoLegal(const Board *board, int move) {
+    return move != 0 && ttMoveToMove(board, moveToTTMove(move)) == move;
+}
+
+// Checkers and absolutely pinned pieces of the side to move, computed once per node
+struct CheckInfo {
+    int kingSquare;
+    U64 checkers;
+    U64 pinned;
+};
+
+static inline void computeCheckInfo(const Board *board, CheckInfo *info) {
+    int us = board->sideToMove;
+    int them = us ^ 1;
+    U64 occ = board->occupancies[both];
+    int kingSquare = getLSBindex(board->bitboards[us == white ? K : k]);
+
+    info->kingSquare = kingSquare;
+    info->checkers = getAttackersToSquare(board, kingSquare, occ) & board->occupancies[them];
+    info->pinned = 0ULL;
+
+    U64 enemyQueens = board->bitboards[them == white ? Q : q];
+    U64 snipers = (getRookAttacks(kingSquare, 0ULL) & (board->bitboards[them == white ? R : r] | enemyQueens)) |
+                  (getBishopAttacks(kingSquare, 0ULL) & (board->bitboards[them == white ? B : b] | enemyQueens));
+    while (snipers) {
+        int sniper = getLSBindex(snipers);
+        U64 blockers = betweenMasks[kingSquare][sniper] & occ;
+        if (blockers && !(blockers & (blockers - 1)))
+            info->pinned |= blockers & board->occupancies[us];
+        popBit(snipers, sniper);
+    }
+}
+
+// En passant removes two pawns from one rank, so it is verified against the resulting occupancy
+static inline bool isEnPassantLegal(const Board *board, int source, int target, int kingSquare) {
+    int us = board->sideToMove;
+    int capturedSquare = target + (us == white ? -8 : 8);
+    U64 occ = (board->occupancies[both] ^ (1ULL << source) ^ (1ULL << capturedSquare)) | (1ULL << target);
+    return !(getAttackersToSquare(board, kingSquare, occ) & board->occupancies[us ^ 1]);
+}
+
+// Legality test for a pseudo-legal move, replacing the make-and-test-king approach
+static inline bool isLegal(const Board *board, int move, const CheckInfo *info) {
+    int source = decodeSource(move);
+    int target = decodeTarget(move);
+    U64 enemy = board->occupancies[board->sideToMove ^ 1];
+
+    if (source == info->kingSquare) {
+        // Castling transit squares are checked by the generators, the destination is checked here
+        U64 occ = board->occupancies[both] ^ (1ULL << source);
+        return !(getAttackersToSquare(board, target, occ) & enemy);
+    }
+
+    if (decodeEnPassant(move))
+        return isEnPassantLegal(board, source, target, info->kingSquare);
+
+    if (info->checkers) {
+        if (info->checkers & (info->checkers - 1))
+            return false;
+        U64 evasions = info->checkers | betweenMasks[info->kingSquare][getLSBindex(info->checkers)];
+        if (!(evasions & (1ULL << target)))
+            return false;
+    }
+
+    if (info->pinned & (1ULL << source))
+        return (lineMasks[info->kingSquare][source] & (1ULL << target)) != 0;
+
+    return true;
+}
+
+static inline void addPawnMoves(MoveList *moves, int source, int target, int pawn, int capture, bool promotion) {
+    if (promotion) {
+        addMove(moves, encodeMove(source, target, pawn, pawn + Q, capture, 0, 0, 0));
+        addMove(moves, encodeMove(source, target, pawn, pawn + R, capture, 0, 0, 0));
+        addMove(moves, encodeMove(source, target, pawn, pawn + B, capture, 0, 0, 0));
+        addMove(moves, encodeMove(source, target, pawn, pawn + N, capture, 0, 0, 0));
+    } else {
+        addMove(moves, encodeMove(source, target, pawn, 0, capture, 0, 0, 0));
+    }
+}
+
+// Fully legal move generator. Pins and checks are resolved up front, so every move in
+// the list can be played with makeMoveUnchecked. In double check only king moves are
+// produced; in single check non-king moves are restricted to capturing or blocking.
+static inline void generateLegalMoves(Board *board, MoveList *moves) {
+    moves->count = 0;
+    int source, target;
+    U64 bitboard, attacks;
+
+    CheckInfo info;
+    computeCheckInfo(board, &info);
+
+    int us = board->sideToMove;
+    int them = us ^ 1;
+    U64 friendly = board->occupancies[us];
+    U64 enemy = board->occupancies[them];
+    U64 occ = board->occupancies[both];
+    int kingSquare = info.kingSquare;
+    int pawnPiece = us == white ? P : p;
+    int kingPiece = us == white ? K : k;
+
+    // King moves, tested with the king lifted off the board so sliders see through it
+    U64 occWithoutKing = occ ^ (1ULL << kingSquare);
+    attacks = kingAttacks[kingSquare] & ~friendly;
+    while (attacks) {
+        target = getLSBindex(attacks);
+        if (!(getAttackersToSquare(board, target, occWithoutKing) & enemy))
+            addMove(moves, encodeMove(kingSquare, target, kingPiece, 0, getBit(enemy, target) ? 1 : 0, 0, 0, 0));
+        popBit(attacks, target);
+    }
+
+    if (info.checkers & (info.checkers - 1))
+        return; // double check
+
+    U64 targetMask = ~friendly;
+    if (info.checkers)
+        targetMask = info.checkers | betweenMasks[kingSquare][getLSBindex(info.checkers)];
+
+    // Castling (never out of check)
+    if (!info.checkers) {
+        if (us == white) {
+            if ((board->castlingRights & wk) && !getBit(occ, f1) && !getBit(occ, g1) &&
+                !isSquareAttacked(board, f1, black) && !isSquareAttacked(board, g1, black))
+                addMove(moves, encodeMove(e1, g1, K, 0, 0, 0, 0, 1));
+            if ((board->castlingRights & wq) && !getBit(occ, d1) && !getBit(occ, c1) && !getBit(occ, b1) &&
+                !isSquareAttacked(board, d1, black) && !isSquareAttacked(board, c1, black))
+                addMove(moves, encodeMove(e1, c1, K, 0, 0, 0, 0, 1));
+        } else {
+            if ((board->castlingRights & bk) && !getBit(occ, f8) && !getBit(occ, g8) &&
+                !isSquareAttacked(board, f8, white) && !isSquareAttacked(board, g8, white))
+                addMove(moves, encodeMove(e8, g8, k, 0, 0, 0, 0, 1));
+            if ((board->castlingRights & bq) && !getBit(occ, d8) && !getBit(occ, c8) && !getBit(occ, b8) &&
+                !isSquareAttacked(board, d8, white) && !isSquareAttacked(board, c8, white))
+                addMove(moves, encodeMove(e8, c8, k, 0, 0, 0, 0, 1));
+        }
+    }
+
+    // Knights, bishops, rooks and queens. Pinned knights can never move, pinned sliders
+    // stay on the line through their king.
+    for (int piece = pawnPiece + N; piece <= pawnPiece + Q; ++piece) {
+        bitboard = board->bitboards[piece];
+        if (piece == pawnPiece + N) bitboard &= ~info.pinned;
+        while (bitboard) {
+            source = getLSBindex(bitboard);
+            switch (piece - pawnPiece) {
+                case N: attacks = knightAttacks[source]; break;
+                case B: attacks = getBishopAttacks(source, occ); break;
+                case R: attacks = getRookAttacks(source, occ); break;
+                default: attacks = getQueenAttacks(source, occ); break;
+            }
+            attacks &= targetMask;
+            if (getBit(info.pinned, source)) attacks &= lineMasks[kingSquare][source];
+            while (attacks) {
+                target = getLSBindex(attacks);
+                addMove(moves, encodeMove(source, target, piece, 0, getBit(enemy, target) ? 1 : 0, 0, 0, 0));
+                popBit(attacks, target);
+            }
+            popBit(bitboard, source);
+        }
+    }
+
+    // Pawns
+    int forward = us == white ? 8 : -8;
+    U64 startRank = us == white ? RANK_2 : RANK_7;
+    U64 promotionRank = us == white ? RANK_8 : RANK_1;
+    bitboard = board->bitboards[pawnPiece];
+    while (bitboard) {
+        source = getLSBindex(bitboard);
+        U64 allowed = targetMask;
+        if (getBit(info.pinned, source)) allowed &= lineMasks[kingSquare][source];
+
+        target = source + forward;
+        if (!getBit(occ, target)) {
+            if (getBit(allowed, target))
+                addPawnMoves(moves, source, target, pawnPiece, 0, (1ULL << target) & promotionRank);
+            int doubleTarget = target + forward;
+            if (((1ULL << source) & startRank) && !getBit(occ, doubleTarget) && getBit(allowed, doubleTarget))
+                addMove(moves, encodeMove(source, doubleTarget, pawnPiece, 0, 0, 1, 0, 0));
+        }
+
+        attacks = pawnAttacks[us][source] & enemy & allowed;
+        while (attacks) {
+            target = getLSBindex(attacks);
+            addPawnMoves(moves, source, target, pawnPiece, 1, (1ULL << target) & promotionRank);
+            popBit(attacks, target);
+        }
+
+        if (board->enPassantSquare != noSquare && (pawnAttacks[us][source] & (1ULL << board->enPassantSquare)) &&
+            isEnPassantLegal(board, source, board->enPassantSquare, kingSquare))
+            addMove(moves, encodeMove(source, board->enPassantSquare, pawnPiece, 0, 1, 0, 1, 0));
+
+        popBit(bitboard, source);
+    }
+}
+
 static inline std::string moveToUCI(int move) {
     int source = decodeSource(move);
     int target = decodeTarget(move);
@@ -562,7 +973,16 @@ static inline void printMoveList(const MoveList *list) {
 }
 
 
-static inline int makeMove(Board *board, int move) {
+// Plays a move that is already known to be legal (from generateLegalMoves or isLegal).
+// The state needed to take it back is written to undo.
+static inline void makeMoveUnchecked(Board *board, int move, StateInfo *undo) {
+    undo->zobristHash = board->zobristHash;
+    undo->pawnHash = board->pawnHash;
+    undo->halfMoveClock = (uint16_t)board->halfMoveClock;
+    undo->castlingRights = (uint8_t)board->castlingRights;
+    undo->enPassantSquare = (uint8_t)board->enPassantSquare;
+    undo->capturedPiece = none;
+
     int source = decodeSource(move);
     int target = decodeTarget(move);
     int piece = decodePiece(move);
@@ -572,39 +992,53 @@ static inline int makeMove(Board *board, int move) {
     int enPass = decodeEnPassant(move);
     int castling = decodeCastling(move);
 
+    if (capture && !enPass) {
+        int capturedPiece = board->pieceOn[target];
+        popBit(board->bitboards[capturedPiece], target);
+        board->zobristHash ^= pieceZobristKeys[capturedPiece][target];
+        if (capturedPiece == P || capturedPiece == p)
+            board->pawnHash ^= pieceZobristKeys[capturedPiece][target];
+        removePieceScores(board, capturedPiece, target);
+        undo->capturedPiece = (uint8_t)capturedPiece;
+    }
+
     popBit(board->bitboards[piece], source);
     setBit(board->bitboards[piece], target);
+    board->pieceOn[source] = none;
+    board->pieceOn[target] = (uint8_t)piece;
+    movePieceScores(board, piece, source, target);
 
     board->zobristHash ^= pieceZobristKeys[piece][source];
     board->zobristHash ^= pieceZobristKeys[piece][target];
 
     board->halfMoveClock++;
 
-    if (piece == P || piece == p) board->halfMoveClock = 0; // Reset half-move clock for pawn moves
-
-    if (capture) {
-        int startPiece = (board->sideToMove == white) ? p : P;
-        int endPiece = (board->sideToMove == white) ? k : K;
-        for (int bbPiece = startPiece; bbPiece <= endPiece; ++bbPiece) {
-            if (getBit(board->bitboards[bbPiece], target)) {
-                popBit(board->bitboards[bbPiece], target);
-                board->zobristHash ^= pieceZobristKeys[bbPiece][target];
-                break;
-            }
-        }
-        board->halfMoveClock = 0; // Reset half-move clock on capture
+    if (piece == P || piece == p) {
+        board->halfMoveClock = 0; // Reset half-move clock for pawn moves
+        board->pawnHash ^= pieceZobristKeys[piece][source];
+        if (!promotedPiece) board->pawnHash ^= pieceZobristKeys[piece][target];
     }
+    if (capture) board->halfMoveClock = 0; // Reset half-move clock on capture
 
     if (promotedPiece) {
         popBit(board->bitboards[piece], target);
         setBit(board->bitboards[promotedPiece], target);
+        board->pieceOn[target] = (uint8_t)promotedPiece;
+        removePieceScores(board, piece, target);
+        addPieceScores(board, promotedPiece, target);
         board->zobristHash ^= pieceZobristKeys[piece][target];
         board->zobristHash ^= pieceZobristKeys[promotedPiece][target];
     }
 
     if (enPass) {
-        popBit(board->bitboards[(board->sideToMove == white) ? p : P], target + (board->sideToMove == white ? -8 : 8));
-        board->zobristHash ^= pieceZobristKeys[(board->sideToMove == white) ? p : P][target + (board->sideToMove == white ? -8 : 8)];
+        int capturedPawn = (board->sideToMove == white) ? p : P;
+        int captureSquare = target + (board->sideToMove == white ? -8 : 8);
+        undo->capturedPiece = (uint8_t)capturedPawn;
+        popBit(board->bitboards[capturedPawn], captureSquare);
+        board->pieceOn[captureSquare] = none;
+        board->zobristHash ^= pieceZobristKeys[capturedPawn][captureSquare];
+        board->pawnHash ^= pieceZobristKeys[capturedPawn][captureSquare];
+        removePieceScores(board, capturedPawn, captureSquare);
     }
 
     board->zobristHash ^= enpassantZobristKeys[board->enPassantSquare]; // I have defined ep zobrist keys to be of lenth 65
@@ -620,24 +1054,36 @@ static inline int makeMove(Board *board, int move) {
             case g1:
                 popBit(board->bitboards[R], h1);
                 setBit(board->bitboards[R], f1);
+                board->pieceOn[h1] = none;
+                board->pieceOn[f1] = R;
+                movePieceScores(board, R, h1, f1);
                 board->zobristHash ^= pieceZobristKeys[R][h1];
                 board->zobristHash ^= pieceZobristKeys[R][f1];
                 break;
             case c1:
                 popBit(board->bitboards[R], a1);
                 setBit(board->bitboards[R], d1);
+                board->pieceOn[a1] = none;
+                board->pieceOn[d1] = R;
+                movePieceScores(board, R, a1, d1);
                 board->zobristHash ^= pieceZobristKeys[R][a1];
                 board->zobristHash ^= pieceZobristKeys[R][d1];
                 break;
             case g8:
                 popBit(board->bitboards[r], h8);
                 setBit(board->bitboards[r], f8);
+                board->pieceOn[h8] = none;
+                board->pieceOn[f8] = r;
+                movePieceScores(board, r, h8, f8);
                 board->zobristHash ^= pieceZobristKeys[r][h8];
                 board->zobristHash ^= pieceZobristKeys[r][f8];
                 break;
             case c8:
                 popBit(board->bitboards[r], a8);
                 setBit(board->bitboards[r], d8);
+                board->pieceOn[a8] = none;
+                board->pieceOn[d8] = r;
+                movePieceScores(board, r, a8, d8);
                 board->zobristHash ^= pieceZobristKeys[r][a8];
                 board->zobristHash ^= pieceZobristKeys[r][d8];
                 break;
@@ -680,6 +1126,81 @@ static inline int makeMove(Board *board, int move) {
 
     board->sideToMove ^= 1;
     board->zobristHash ^= sideZobristKey;
+}
+
+// Reverts makeMoveUnchecked using the state it saved
+static inline void unmakeMove(Board *board, int move, const StateInfo *undo) {
+    int source = decodeSource(move);
+    int target = decodeTarget(move);
+    int piece = decodePiece(move);
+    int promotedPiece = decodePromoted(move);
+    int castling = decodeCastling(move);
+    int capturedPiece = undo->capturedPiece;
+
+    board->sideToMove ^= 1;
+    int side = board->sideToMove;
+    int opponent = side ^ 1;
+
+    popBit(board->bitboards[promotedPiece ? promotedPiece : piece], target);
+    setBit(board->bitboards[piece], source);
+    board->pieceOn[target] = none;
+    board->pieceOn[source] = (uint8_t)piece;
+    if (promotedPiece) {
+        removePieceScores(board, promotedPiece, target);
+        addPieceScores(board, piece, target);
+    }
+    movePieceScores(board, piece, target, source);
+    board->occupancies[side] ^= (1ULL << source) | (1ULL << target);
+
+    if (capturedPiece != none) {
+        int captureSquare = decodeEnPassant(move) ? target + (side == white ? -8 : 8) : target;
+        setBit(board->bitboards[capturedPiece], captureSquare);
+        board->pieceOn[captureSquare] = (uint8_t)capturedPiece;
+        addPieceScores(board, capturedPiece, captureSquare);
+        board->occupancies[opponent] |= (1ULL << captureSquare);
+    }
+
+    if (castling) {
+        switch (target) {
+            case g1: board->bitboards[R] ^= (1ULL << h1) | (1ULL << f1); board->occupancies[white] ^= (1ULL << h1) | (1ULL << f1); board->pieceOn[h1] = R; board->pieceOn[f1] = none; movePieceScores(board, R, f1, h1); break;
+            case c1: board->bitboards[R] ^= (1ULL << a1) | (1ULL << d1); board->occupancies[white] ^= (1ULL << a1) | (1ULL << d1); board->pieceOn[a1] = R; board->pieceOn[d1] = none; movePieceScores(board, R, d1, a1); break;
+            case g8: board->bitboards[r] ^= (1ULL << h8) | (1ULL << f8); board->occupancies[black] ^= (1ULL << h8) | (1ULL << f8); board->pieceOn[h8] = r; board->pieceOn[f8] = none; movePieceScores(board, r, f8, h8); break;
+            case c8: board->bitboards[r] ^= (1ULL << a8) | (1ULL << d8); board->occupancies[black] ^= (1ULL << a8) | (1ULL << d8); board->pieceOn[a8] = r; board->pieceOn[d8] = none; movePieceScores(board, r, d8, a8); break;
+        }
+    }
+
+    board->occupancies[both] = board->occupancies[white] | board->occupancies[black];
+    board->occupancies[3] = ~board->occupancies[both];
+
+    board->zobristHash = undo->zobristHash;
+    board->pawnHash = undo->pawnHash;
+    board->halfMoveClock = undo->halfMoveClock;
+    board->castlingRights = undo->castlingRights;
+    board->enPassantSquare = undo->enPassantSquare;
+}
+
+// Passes the move to the opponent, used by null move pruning
+static inline void makeNullMove(Board *board, StateInfo *undo) {
+    undo->zobristHash = board->zobristHash;
+    undo->enPassantSquare = (uint8_t)board->enPassantSquare;
+
+    board->zobristHash ^= enpassantZobristKeys[board->enPassantSquare];
+    board->enPassantSquare = noSquare;
+    board->zobristHash ^= sideZobristKey;
+    board->sideToMove ^= 1;
+}
+
+static inline void unmakeNullMove(Board *board, const StateInfo *undo) {
+    board->sideToMove ^= 1;
+    board->zobristHash = undo->zobristHash;
+    board->enPassantSquare = undo->enPassantSquare;
+}
+
+// Copy-make interface: plays the move and reports whether it was legal, the caller
+// restores the board with takeBack either way
+static inline int makeMove(Board *board, int move) {
+    StateInfo undo;
+    makeMoveUnchecked(board, move, &undo);
 
     int kingSquare = (board->sideToMove == white)
         ? getLSBindex(board->bitboards[k])
@@ -433,11 +433,36 @@ static inline U64 getQueenAttacks(int square, U64 occupancy) {
     return getBishopAttacks(square, occupancy) | getRookAttacks(square, occupancy);
 }
 
+// Squares strictly between two aligned squares, and the full line through them (0 if not aligned)
+static U64 betweenMasks[64][64];
+static U64 lineMasks[64][64];
+
+static inline void initializeLineMasks() {
+    for (int from = 0; from < 64; from++) {
+        for (int to = 0; to < 64; to++) {
+            betweenMasks[from][to] = 0ULL;
+            lineMasks[from][to] = 0ULL;
+            if (from == to) continue;
+
+            U64 fromBit = 1ULL << from;
+            U64 toBit = 1ULL << to;
+            if (rookAttackOnTheFly(from, 0ULL) & toBit) {
+                betweenMasks[from][to] = rookAttackOnTheFly(from, toBit) & rookAttackOnTheFly(to, fromBit);
+                lineMasks[from][to] = (rookAttackOnTheFly(from, 0ULL) & rookAttackOnTheFly(to, 0ULL)) | fromBit | toBit;
+            } else if (bishopAttackOnTheFly(from, 0ULL) & toBit) {
+                betweenMasks[from][to] = bishopAttackOnTheFly(from, toBit) & bishopAttackOnTheFly(to, fromBit);
+                lineMasks[from][to] = (bishopAttackOnTheFly(from, 0ULL) & bishopAttackOnTheFly(to, 0ULL)) | fromBit | toBit;
+            }
+        }
+    }
+}
+
 static inline void initializeMoveTables() {
     initializeLeaperAttacks();
     //initializeMagicNumbers();
     initializeSliderAttacks(bishop);
     initializeSliderAttacks(rook);
+    initializeLineMasks();
 }
 
 #endif // PRECALCULATED_MOVE_TABLES_H
@@ -22,6 +22,19 @@ static inline U64 generateRandomU64() {
     return n1 | (n2 << 16) | (n3 << 32) | (n4 << 48);
 }
 
+// Zobrist keys come from a 64-bit splitmix generator. Keys stitched together from
+// 16-bit pieces of the 32-bit xorshift above are all linear in one 32-bit state, so
+// any xor of them only carries 32 bits of information and TT verification bits past
+// the bucket index added nothing.
+static U64 zobristRandomState = 0x9E3779B97F4A7C15ULL;
+
+static inline U64 generateZobristKey() {
+    U64 z = (zobristRandomState += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
 static inline U64 generateMagicNumber(){
     return generateRandomU64() & generateRandomU64() & generateRandomU64();
 }
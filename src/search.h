@@ -3,6 +3,9 @@
 
 #include "evaluate.h"
 #include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
 
 struct ScoredMove {
     int move;
@@ -15,10 +18,23 @@ struct SearchUCI {
     long long startTime;
     long long stopTime;
     int increment;
-    int quit;
-    int stop;
-
-    SearchUCI() : depth(10), timedGame(0), startTime(0), stopTime(0), increment(0), quit(0), stop(0) {}
+    int pollInput; // 0 when stdin is not a UCI stream, e.g. a command-line bench
+    std::atomic<int> quit; // shared with helper threads
+    std::atomic<int> stop;
+
+    SearchUCI() : depth(10), timedGame(0), startTime(0), stopTime(0), increment(0), pollInput(1), quit(0), stop(0) {}
+
+    SearchUCI &operator=(const SearchUCI &other) {
+        depth = other.depth;
+        timedGame = other.timedGame;
+        startTime = other.startTime;
+        stopTime = other.stopTime;
+        increment = other.increment;
+        pollInput = other.pollInput;
+        quit = other.quit.load();
+        stop = other.stop.load();
+        return *this;
+    }
 };
 
 static inline void read_input(SearchUCI *searchParams) 
@@ -56,7 +72,7 @@ static inline void communicate(SearchUCI *searchParams) {
     if (searchParams->timedGame && TIME_IN_MILLISECONDS >= searchParams->stopTime) {
         searchParams->stop = 1; // Stop the search if time is up
     }
-    read_input(searchParams);
+    if (searchParams->pollInput) read_input(searchParams);
 }
 
 // global initialization
@@ -66,10 +82,6 @@ static SearchUCI searchParams[1];
 const int maxPly = 64;
 const int HISTORY_MAX = 8192;
 
-// Search parameters
-static int ply; 
-static U64 searchedNodes;
-
 // Late Move Reduction (LMR) parameters
 const int FullDepthMoves = 4;
 const int ReductionLimit = 3;
@@ -95,17 +107,6 @@ static const int seeValues[12] = {
     100, 300, 300, 500, 900, 20000
 };
 
-static inline U64 getAttackersToSquare(const Board *board, int square, U64 occ) {
-    U64 attackers = 0ULL;
-    attackers |= pawnAttacks[black][square] & board->bitboards[P];
-    attackers |= pawnAttacks[white][square] & board->bitboards[p];
-    attackers |= knightAttacks[square] & (board->bitboards[N] | board->bitboards[n]);
-    attackers |= getBishopAttacks(square, occ) & (board->bitboards[B] | board->bitboards[b] | board->bitboards[Q] | board->bitboards[q]);
-    attackers |= getRookAttacks(square, occ) & (board->bitboards[R] | board->bitboards[r] | board->bitboards[Q] | board->bitboards[q]);
-    attackers |= kingAttacks[square] & (board->bitboards[K] | board->bitboards[k]);
-    return attackers & occ;
-}
-
 static inline int getLeastValuableAttacker(const Board *board, U64 attackers, int side, int &piece) {
     int start = (side == white) ? P : p;
     int end = (side == white) ? K : k;
@@ -128,20 +129,8 @@ static inline int see(const Board *board, int move) {
     int depth_see = 0;
 
     int capturedPiece = none;
-    if (decodeCapture(move)) {
-        if (decodeEnPassant(move)) {
-            capturedPiece = (board->sideToMove == white) ? p : P;
-        } else {
-            int startPiece = (board->sideToMove == white) ? p : P;
-            int endPiece = (board->sideToMove == white) ? k : K;
-            for (int bbPiece = startPiece; bbPiece <= endPiece; ++bbPiece) {
-                if (getBit(board->bitboards[bbPiece], target)) {
-                    capturedPiece = bbPiece;
-                    break;
-                }
-            }
-        }
-    }
+    if (decodeCapture(move))
+        capturedPiece = decodeEnPassant(move) ? ((board->sideToMove == white) ? p : P) : board->pieceOn[target];
 
     gain[0] = (capturedPiece != none) ? seeValues[capturedPiece] : 0;
     if (decodePromoted(move))
@@ -183,14 +172,9 @@ static inline int see(const Board *board, int move) {
     return gain[0];
 }
 
+// Piece standing on the target square, none for quiet moves and en passant
 static inline int getCapturedPiece(const Board *board, int target) {
-    int startPiece = (board->sideToMove == white) ? p : P;
-    int endPiece = (board->sideToMove == white) ? k : K;
-    for (int bbPiece = startPiece; bbPiece <= endPiece; ++bbPiece) {
-        if (getBit(board->bitboards[bbPiece], target))
-            return bbPiece;
-    }
-    return none;
+    return board->pieceOn[target];
 }
 
 static inline int lmrReduction(int depth, int movesSearched, bool improving) {
@@ -201,120 +185,266 @@ static inline int lmrReduction(int depth, int movesSearched, bool improving) {
     return reduction;
 }
 
-static int killerMoves[2][maxPly];
-static int historyMoves[12][64];
-static int counterMoves[12][64];
-static int prevMovePiece[maxPly];
-static int prevMoveTarget[maxPly];
-static int staticEvalHistory[maxPly];
+// Per-thread search state. Every Lazy SMP thread searches its own copy of the
+// root position and only shares the transposition table and the stop flag.
+struct SearchThread {
+    int id;
+    Board board;
+    int ply;
+    std::atomic<U64> nodes;
 
-static inline void updateHistory(int piece, int target, int bonus) {
-    int clamped = std::max(-HISTORY_MAX, std::min(HISTORY_MAX, bonus));
-    historyMoves[piece][target] += clamped - historyMoves[piece][target] * abs(clamped) / HISTORY_MAX;
-}
+    int killerMoves[2][maxPly];
+    int historyMoves[12][64];
+    int counterMoves[12][64];
+    int prevMovePiece[maxPly];
+    int prevMoveTarget[maxPly];
+    StateInfo undoStack[maxPly]; // state restored by unmakeMove, indexed by ply
+    int staticEvalHistory[maxPly];
 
-// Table to store principal variation moves
-static int PrincipalVariationLength[maxPly]; 
-static int PrincipalVariationTable[maxPly][maxPly];
+    // Table to store principal variation moves
+    int PrincipalVariationLength[maxPly];
+    int PrincipalVariationTable[maxPly][maxPly];
 
-// follow PV flags
-static int followPrincipalVariation, scorePrincipalVariation;
+    // follow PV flag
+    int followPrincipalVariation;
 
-static int gameHistoryPly = 0;
+    // Private copy of the game history so threads can push/pop independently
+    U64 repetitionTable[gameHistorySize + maxPly]; // the game history plus one entry per search ply
+    int repetitionIndex;
 
-// Allows Principal Variation to be evaluated first
-static inline void enablePrincipalVariationScoring(Board *board, MoveList *list) {
-    followPrincipalVariation = 0;
-    for (int i = 0; i < list->count; i++){
-        if (PrincipalVariationTable[0][ply] == list->moves[i]) {
-            scorePrincipalVariation = 1;
-            followPrincipalVariation = 1;
-        }
+    int completedDepth;
+
+    PawnHashTable pawnTable;
+};
+
+static SearchThread *searchThreads = NULL;
+static int numSearchThreads = 0;
+const int maxSearchThreads = 256;
+
+static inline void initializeSearchThreads(int count) {
+    count = std::max(1, std::min(maxSearchThreads, count));
+    if (searchThreads != NULL)
+        delete[] searchThreads;
+    searchThreads = new SearchThread[count];
+    numSearchThreads = count;
+    for (int i = 0; i < count; i++) {
+        searchThreads[i].id = i;
+        memset(&searchThreads[i].pawnTable, 0, sizeof(PawnHashTable));
     }
 }
 
-// Assign score to moves for sorting
-static inline int scoreMove(Board *board, int move) {
-    int piece = decodePiece(move); 
-    int target = decodeTarget(move);
+// Relaxed per-thread counter: only the owning thread writes, the main thread reads for reporting
+static inline void incrementNodes(SearchThread *thread) {
+    thread->nodes.store(thread->nodes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
 
-    if (scorePrincipalVariation){
-        if (PrincipalVariationTable[0][ply] == move) {
-            scorePrincipalVariation = 0;
-            return 20000; // Highest score for principal variation moves
-        }
-    }
+static inline U64 totalSearchedNodes() {
+    U64 total = 0;
+    for (int i = 0; i < numSearchThreads; i++)
+        total += searchThreads[i].nodes.load(std::memory_order_relaxed);
+    return total;
+}
 
-    if (decodeCapture(move)){
-        if (decodeEnPassant(move)) return 10105;
-        int startPiece = (board->sideToMove == white) ? p : P;
-        int endPiece = (board->sideToMove == white) ? k : K;
-        int capturedPiece = P;
-        for (int bbPiece = startPiece; bbPiece <= endPiece; ++bbPiece) {
-            if (getBit(board->bitboards[bbPiece], target)) {
-                capturedPiece = bbPiece;
-                break;
-            }
-        }
-        int mvvlva = seeValues[capturedPiece] - seeValues[piece] / 100;
-        if (seeValues[capturedPiece] >= seeValues[piece])
-            return 10000 + mvvlva;
-        if (see(board, move) >= 0)
-            return 10000 + mvvlva;
-        return mvvlva - 1000;
-    }
-    else{
-        if (killerMoves[0][ply] == move) return 9000;
-        if (killerMoves[1][ply] == move) return 8000;
-        if (ply > 0 && counterMoves[prevMovePiece[ply - 1]][prevMoveTarget[ply - 1]] == move)
-            return 7000;
-        return historyMoves[piece][target];
-    }
-    return 0;
+static inline void updateHistory(SearchThread *thread, int piece, int target, int bonus) {
+    int clamped = std::max(-HISTORY_MAX, std::min(HISTORY_MAX, bonus));
+    thread->historyMoves[piece][target] += clamped - thread->historyMoves[piece][target] * abs(clamped) / HISTORY_MAX;
 }
 
-// Print move scores for debugging
-static inline void printMoveScores(Board *board, MoveList *list) {
-    std::cout << "Move Scores:" << std::endl;
-    for (int i = 0; i < list->count; ++i) {
-        int move = list->moves[i];
-        int score = scoreMove(board, move);
-        std::cout << "Move: " << moveToUCI(move) << " Score: " << score << std::endl;
+static int gameHistoryPly = 0;
+
+// Staged move picker. Moves are produced lazily so that a cutoff on the hash move or
+// an early capture never pays for generating and scoring the quiet moves.
+enum {
+    stageTTMove, stageGenerateCaptures, stageGoodCaptures, stageKiller1, stageKiller2,
+    stageCounterMove, stageGenerateQuiets, stageQuiets, stageBadCaptures, stageDone
+};
+
+struct MovePicker {
+    SearchThread *thread;
+    int stage;
+    int captureOnly; // qsearch variant: hash move and winning captures only
+    int ttMove;
+    int killer1, killer2, counterMove;
+    MoveList captures; // losing captures are parked at the front as they are rejected
+    MoveList quiets;
+    int scores[300];
+    int current;
+    int badCount;
+};
+
+static inline void initMovePicker(MovePicker *picker, SearchThread *thread, int ttMove, int captureOnly) {
+    Board *board = &thread->board;
+    int ply = thread->ply;
+
+    picker->thread = thread;
+    picker->stage = stageTTMove;
+    picker->captureOnly = captureOnly;
+    picker->ttMove = ttMoveToMove(board, (uint16_t)ttMove);
+    if (captureOnly && !decodeCapture(picker->ttMove))
+        picker->ttMove = 0;
+
+    picker->killer1 = picker->killer2 = picker->counterMove = 0;
+    if (!captureOnly) {
+        picker->killer1 = thread->killerMoves[0][ply];
+        picker->killer2 = thread->killerMoves[1][ply];
+        if (ply > 0)
+            picker->counterMove = thread->counterMoves[thread->prevMovePiece[ply - 1]][thread->prevMoveTarget[ply - 1]];
     }
+    picker->current = 0;
+    picker->badCount = 0;
 }
 
-static int moveScores[maxPly + 1][300];
+// Winning or equal captures and queen promotions; everything else is tried last
+static inline bool isGoodCapture(const Board *board, int move) {
+    if (!decodeCapture(move))
+        return decodePromoted(move) % 6 == Q;
+    if (decodeEnPassant(move))
+        return true;
+    int capturedPiece = getCapturedPiece(board, decodeTarget(move));
+    if (seeValues[capturedPiece] >= seeValues[decodePiece(move)])
+        return true;
+    return see(board, move) >= 0;
+}
 
-static inline void scoreMoves(Board *board, MoveList *list, int bestMove, int searchPly) {
-    for (int i = 0; i < list->count; ++i) {
-        if (bestMove != 0 && ttMoveMatch(list->moves[i], (uint16_t)bestMove))
-            moveScores[searchPly][i] = 30000;
-        else
-            moveScores[searchPly][i] = scoreMove(board, list->moves[i]);
+static inline void scoreCaptures(MovePicker *picker) {
+    Board *board = &picker->thread->board;
+    for (int i = 0; i < picker->captures.count; ++i) {
+        int move = picker->captures.moves[i];
+        int promoted = decodePromoted(move);
+        int victim = decodeEnPassant(move) ? P : getCapturedPiece(board, decodeTarget(move));
+        int score = (victim != none ? seeValues[victim] : 0) - seeValues[decodePiece(move)] / 100;
+        if (promoted) score += seeValues[promoted];
+        picker->scores[i] = score;
     }
 }
 
-static inline void pickMove(MoveList *list, int startIdx, int searchPly) {
+static inline void scoreQuiets(MovePicker *picker) {
+    SearchThread *thread = picker->thread;
+    for (int i = 0; i < picker->quiets.count; ++i) {
+        int move = picker->quiets.moves[i];
+        picker->scores[i] = thread->historyMoves[decodePiece(move)][decodeTarget(move)];
+    }
+}
+
+// Selection step: swaps the best remaining move to startIdx
+static inline void pickMove(MoveList *list, int *scores, int startIdx) {
     int bestIdx = startIdx;
-    int bestScore = moveScores[searchPly][startIdx];
+    int bestScore = scores[startIdx];
     for (int i = startIdx + 1; i < list->count; ++i) {
-        if (moveScores[searchPly][i] > bestScore) {
-            bestScore = moveScores[searchPly][i];
+        if (scores[i] > bestScore) {
+            bestScore = scores[i];
             bestIdx = i;
         }
     }
     if (bestIdx != startIdx) {
         std::swap(list->moves[startIdx], list->moves[bestIdx]);
-        std::swap(moveScores[searchPly][startIdx], moveScores[searchPly][bestIdx]);
+        std::swap(scores[startIdx], scores[bestIdx]);
+    }
+}
+
+// Killer and counter moves are only tried if they are still quiet and pseudo-legal here
+static inline bool isRefutationCandidate(MovePicker *picker, int move) {
+    return move != 0 && move != picker->ttMove && !decodeCapture(move) && !decodePromoted(move) &&
+           isPseudoLegal(&picker->thread->board, move);
+}
+
+// Returns the next move to search, or 0 once all stages are exhausted
+static inline int nextMove(MovePicker *picker) {
+    Board *board = &picker->thread->board;
+    int move;
+
+    switch (picker->stage) {
+        case stageTTMove:
+            picker->stage = stageGenerateCaptures;
+            if (picker->ttMove)
+                return picker->ttMove;
+            // fall through
+        case stageGenerateCaptures:
+            generateCaptures(board, &picker->captures);
+            scoreCaptures(picker);
+            picker->current = 0;
+            picker->badCount = 0;
+            picker->stage = stageGoodCaptures;
+            // fall through
+        case stageGoodCaptures:
+            while (picker->current < picker->captures.count) {
+                pickMove(&picker->captures, picker->scores, picker->current);
+                move = picker->captures.moves[picker->current++];
+                if (move == picker->ttMove)
+                    continue;
+                if (!isGoodCapture(board, move)) {
+                    picker->captures.moves[picker->badCount++] = move;
+                    continue;
+                }
+                return move;
+            }
+            if (picker->captureOnly) {
+                picker->stage = stageDone;
+                return 0;
+            }
+            picker->stage = stageKiller1;
+            // fall through
+        case stageKiller1:
+            picker->stage = stageKiller2;
+            if (isRefutationCandidate(picker, picker->killer1))
+                return picker->killer1;
+            // fall through
+        case stageKiller2:
+            picker->stage = stageCounterMove;
+            if (picker->killer2 != picker->killer1 && isRefutationCandidate(picker, picker->killer2))
+                return picker->killer2;
+            // fall through
+        case stageCounterMove:
+            picker->stage = stageGenerateQuiets;
+            if (picker->counterMove != picker->killer1 && picker->counterMove != picker->killer2 &&
+                isRefutationCandidate(picker, picker->counterMove))
+                return picker->counterMove;
+            // fall through
+        case stageGenerateQuiets:
+            generateQuiets(board, &picker->quiets);
+            scoreQuiets(picker);
+            picker->current = 0;
+            picker->stage = stageQuiets;
+            // fall through
+        case stageQuiets:
+            while (picker->current < picker->quiets.count) {
+                pickMove(&picker->quiets, picker->scores, picker->current);
+                move = picker->quiets.moves[picker->current++];
+                if (move == picker->ttMove || move == picker->killer1 ||
+                    move == picker->killer2 || move == picker->counterMove)
+                    continue;
+                return move;
+            }
+            picker->current = 0;
+            picker->stage = stageBadCaptures;
+            // fall through
+        case stageBadCaptures:
+            if (picker->current < picker->badCount)
+                return picker->captures.moves[picker->current++];
+            picker->stage = stageDone;
+            // fall through
+        default:
+            return 0;
     }
 }
 
-static inline int detectRepetition(Board *board) {
+// Print move ordering for debugging
+static inline void printMoveScores(SearchThread *thread) {
+    MovePicker picker;
+    initMovePicker(&picker, thread, 0, 0);
+    std::cout << "Move Order:" << std::endl;
+    int move;
+    while ((move = nextMove(&picker)) != 0)
+        std::cout << "Move: " << moveToUCI(move) << " Stage: " << picker.stage << std::endl;
+}
+
+static inline int detectRepetition(SearchThread *thread) {
+    Board *board = &thread->board;
     if (board->halfMoveClock < 4)
         return 0;
-    int limit = std::max(0, repetitionIndex - board->halfMoveClock);
-    for (int i = repetitionIndex - 2; i >= limit; i -= 2) {
-        if (repetitionTable[i] == board->zobristHash) {
+    int limit = std::max(0, thread->repetitionIndex - board->halfMoveClock);
+    for (int i = thread->repetitionIndex - 2; i >= limit; i -= 2) {
+        if (thread->repetitionTable[i] == board->zobristHash) {
             return 1;
         }
     }
@@ -322,39 +452,42 @@ static inline int detectRepetition(Board *board) {
 }
 
 static inline int numLegalMovesInPosition(Board *board) {
-    int legalMoves = 0;
     MoveList moveList;
-    generateMoves(board, &moveList);
-    copyBoard(board);
-    for (int i = 0; i < moveList.count; ++i) {
-        if (makeMove(board, moveList.moves[i]) == 0) { takeBack(board, backup); continue; }
-        legalMoves++;
-        takeBack(board, backup); // Restore the board state
-    }
-    return legalMoves;
+    generateLegalMoves(board, &moveList);
+    return moveList.count;
 }
 
 // Quiescence search to handle captures and captures that lead to checks
-static inline int quiescenceSearch(Board *board, int alpha, int beta, int qDepth = 0) {
+// Most material a capture can win, which delta pruning adds to the static eval; en passant
+// has no piece on the target and counts as a pawn
+static inline int deltaCaptureGain(const Board *board, int move) {
+    if (decodePromoted(move))
+        return captureValue[(board->sideToMove == white) ? Q : q];
+    int victim = getCapturedPiece(board, decodeTarget(move));
+    return (victim != none) ? captureValue[victim] : 82;
+}
 
-    if ((searchedNodes & 1023) == 0) 
+static inline int quiescenceSearch(SearchThread *thread, int alpha, int beta, int qDepth = 0) {
+    Board *board = &thread->board;
+
+    if (thread->id == 0 && (thread->nodes.load(std::memory_order_relaxed) & 1023) == 0) 
         communicate(searchParams);
 
-    searchedNodes++;
+    incrementNodes(thread);
 
-    if (ply > maxPly - 1) 
-        return evaluate(board);
+    if (thread->ply > maxPly - 1) 
+        return evaluate(board, &thread->pawnTable);
 
-    TTProbeResult ttProbe = probeHashEntry(board, alpha, beta, 0, ply);
+    TTProbeResult ttProbe = probeHashEntry(board, alpha, beta, 0, thread->ply);
     int ttMove = ttProbe.ttMove;
-    if (ttProbe.score != noHashEntry && ply)
+    if (ttProbe.score != noHashEntry && thread->ply)
         return ttProbe.score;
 
     int inCheck = isBoardInCheck(board);
 
     int eval = 0;
     if (!inCheck) {
-        eval = evaluate(board);
+        eval = evaluate(board, &thread->pawnTable);
 
         if (eval >= beta) 
             return beta;
@@ -363,56 +496,43 @@ static inline int quiescenceSearch(Board *board, int alpha, int beta, int qDepth
             alpha = eval;
     } else {
         if (qDepth >= 3)
-            return evaluate(board);
+            return evaluate(board, &thread->pawnTable);
         eval = -INFINITY;
     }
 
-    MoveList moveList;
-    if (inCheck)
-        generateMoves(board, &moveList);
-    else
-        generateCaptures(board, &moveList);
-    int qsPly = ply;
-    scoreMoves(board, &moveList, ttMove, qsPly);
+    // Out of check only the hash move and winning captures are produced
+    MovePicker picker;
+    initMovePicker(&picker, thread, ttMove, !inCheck);
 
-    copyBoard(board);
+    CheckInfo checkInfo;
+    computeCheckInfo(board, &checkInfo);
+    StateInfo *undo = &thread->undoStack[thread->ply];
 
     int legalMoves = 0;
+    int move;
 
-    for (int count = 0; count < moveList.count; ++count) {
-        pickMove(&moveList, count, qsPly);
-        int move = moveList.moves[count];
-
+    while ((move = nextMove(&picker)) != 0) {
         bool isCapture = decodeCapture(move);
 
         if (!inCheck && !isCapture)
             continue;
 
-        if (!inCheck && isCapture) {
-            if (moveScores[qsPly][count] < 0)
-                continue;
-            int victim = getCapturedPiece(board, decodeTarget(move));
-            int gain = (victim != none) ? captureValue[victim] : 82;
-            if (decodePromoted(move))
-                gain = captureValue[(board->sideToMove == white) ? Q : q];
-            if (eval + gain + 200 < alpha)
-                continue;
-        }
+        if (!inCheck && isCapture && eval + deltaCaptureGain(board, move) + 200 < alpha)
+            continue;
 
-        if (makeMove(board, move) == 0) {
-            takeBack(board, backup);
+        if (!isLegal(board, move, &checkInfo))
             continue;
-        }
 
+        makeMoveUnchecked(board, move, undo);
         ttPrefetch(board->zobristHash);
         legalMoves++;
-        ply++;
-        repetitionTable[repetitionIndex++] = board->zobristHash;
-        int score = -quiescenceSearch(board, -beta, -alpha, qDepth + 1);
+        thread->ply++;
+        thread->repetitionTable[thread->repetitionIndex++] = board->zobristHash;
+        int score = -quiescenceSearch(thread, -beta, -alpha, qDepth + 1);
 
-        ply--;
-        repetitionIndex--;
-        takeBack(board, backup);
+        thread->ply--;
+        thread->repetitionIndex--;
+        unmakeMove(board, move, undo);
         
         if (searchParams->stop) {
             return alpha;
@@ -426,15 +546,16 @@ static inline int quiescenceSearch(Board *board, int alpha, int beta, int qDepth
     }
 
     if (inCheck && legalMoves == 0)
-        return -MATEVALUE + ply;
+        return -MATEVALUE + thread->ply;
 
     return alpha;
 }
 
 // main negamax search function
-static inline int negamax(Board *board, int alpha, int beta, int depth) {
+static inline int negamax(SearchThread *thread, int alpha, int beta, int depth) {
+    Board *board = &thread->board;
 
-    if ((searchedNodes & 1023) == 0) 
+    if (thread->id == 0 && (thread->nodes.load(std::memory_order_relaxed) & 1023) == 0) 
         communicate(searchParams);
 
     //static int currentLine[maxPly]; // Track the line of moves searched
@@ -443,9 +564,9 @@ static inline int negamax(Board *board, int alpha, int beta, int depth) {
 
     int bestMove = 0;
 
-    PrincipalVariationLength[ply] = ply;
+    thread->PrincipalVariationLength[thread->ply] = thread->ply;
 
-    if (ply && detectRepetition(board)) {
+    if (thread->ply && detectRepetition(thread)) {
         return 0;
     }
 
@@ -453,7 +574,7 @@ static inline int negamax(Board *board, int alpha, int beta, int depth) {
 
     if (board->halfMoveClock >= 100) {
         if (inCheck && numLegalMovesInPosition(board) == 0)
-            return -MATEVALUE + ply;
+            return -MATEVALUE + thread->ply;
 
         return 0;
     }
@@ -462,9 +583,9 @@ static inline int negamax(Board *board, int alpha, int beta, int depth) {
 
     if (inCheck) depth++;
 
-    TTProbeResult ttProbe = probeHashEntry(board, alpha, beta, depth, ply);
+    TTProbeResult ttProbe = probeHashEntry(board, alpha, beta, depth, thread->ply);
     if (ttProbe.ttMove != 0) bestMove = ttProbe.ttMove;
-    if (ply && ttProbe.score != noHashEntry) {
+    if (thread->ply && ttProbe.score != noHashEntry) {
         if (!PVnode)
             return ttProbe.score;
     }
@@ -472,23 +593,24 @@ static inline int negamax(Board *board, int alpha, int beta, int depth) {
     uint16_t hashMove = (uint16_t)bestMove;
 
     if (depth == 0)
-        return quiescenceSearch(board, alpha, beta);
+        return quiescenceSearch(thread, alpha, beta);
 
-    if (ply > maxPly - 1)
-        return evaluate(board);
+    if (thread->ply > maxPly - 1)
+        return evaluate(board, &thread->pawnTable);
 
-    searchedNodes++;
+    incrementNodes(thread);
 
     int legalMoves = 0;
     int movesSearched = 0;
 
-    int staticEval = (ttProbe.ttEval != -32768) ? ttProbe.ttEval : evaluate(board);
-    staticEvalHistory[ply] = staticEval;
-    bool improving = (ply >= 2 && staticEval > staticEvalHistory[ply - 2]);
+    int ply = thread->ply;
+    int staticEval = (ttProbe.ttEval != -32768) ? ttProbe.ttEval : evaluate(board, &thread->pawnTable);
+    thread->staticEvalHistory[ply] = staticEval;
+    bool improving = (ply >= 2 && staticEval > thread->staticEvalHistory[ply - 2]);
 
     // Internal iterative deepening when no hash move is available
     if (depth >= 5 && bestMove == 0 && !inCheck) {
-        negamax(board, alpha, beta, depth - 2);
+        negamax(thread, alpha, beta, depth - 2);
         TTProbeResult iidProbe = probeHashEntry(board, -INFINITY, INFINITY, 1, ply);
         if (iidProbe.ttMove != 0) bestMove = iidProbe.ttMove;
         hashMove = (uint16_t)bestMove;
@@ -512,22 +634,19 @@ static inline int negamax(Board *board, int alpha, int beta, int depth) {
 
     // Null move pruning
     if (depth >= 3 && !inCheck && ply && !OnlyPawnsOnBoard && staticEval >= beta) {
-        copyBoard(board);
-        ply++;
-        repetitionTable[repetitionIndex++] = board->zobristHash;
+        StateInfo *undo = &thread->undoStack[thread->ply];
+        thread->ply++;
+        thread->repetitionTable[thread->repetitionIndex++] = board->zobristHash;
 
-        board->zobristHash ^= enpassantZobristKeys[board->enPassantSquare];
-        board->enPassantSquare = noSquare;
-        board->zobristHash ^= sideZobristKey;
-        board->sideToMove ^= 1;
+        makeNullMove(board, undo);
 
         int R = nullMoveReduction(depth);
         if (R >= depth) R = depth - 1;
-        score = -negamax(board, -beta, -beta + 1, depth - 1 - R);
+        score = -negamax(thread, -beta, -beta + 1, depth - 1 - R);
 
-        ply--;
-        repetitionIndex--;
-        takeBack(board, backup);
+        thread->ply--;
+        thread->repetitionIndex--;
+        unmakeNullMove(board, undo);
 
         if (searchParams->stop) 
             return alpha;
@@ -543,52 +662,59 @@ static inline int negamax(Board *board, int alpha, int beta, int depth) {
 
         if (score < alpha){
             if (depth == 1){
-                newScore = quiescenceSearch(board, alpha, beta);
+                newScore = quiescenceSearch(thread, alpha, beta);
                 return (newScore > score) ? newScore : score;
             }
             score += 175;
             if (score < alpha && depth <= 2) {
-                newScore = quiescenceSearch(board, alpha, beta);
+                newScore = quiescenceSearch(thread, alpha, beta);
                 if (newScore < alpha) 
                     return (newScore > score) ? newScore : score;
             }
         }
     }
 
-    MoveList moveList;
-    generateMoves(board, &moveList);
+    // Keep following the previous iteration's PV while its move exists here; it is
+    // tried first when the TT has no move for this node
+    int orderMove = bestMove;
+    if (thread->followPrincipalVariation) {
+        int pvMove = thread->PrincipalVariationTable[0][ply];
+        if (isPseudoLegal(board, pvMove)) {
+            if (orderMove == 0) orderMove = moveToTTMove(pvMove);
+        } else {
+            thread->followPrincipalVariation = 0;
+        }
+    }
 
-    if (followPrincipalVariation)
-        enablePrincipalVariationScoring(board, &moveList);
+    MovePicker picker;
+    initMovePicker(&picker, thread, orderMove, 0);
 
-    int nmPly = ply;
-    scoreMoves(board, &moveList, bestMove, nmPly);
-    copyBoard(board);
+    CheckInfo checkInfo;
+    computeCheckInfo(board, &checkInfo);
+    StateInfo *undo = &thread->undoStack[thread->ply];
 
-    for (int count = 0; count < moveList.count; ++count) {
-        pickMove(&moveList, count, nmPly);
-        int move = moveList.moves[count];
+    int move;
+    while ((move = nextMove(&picker)) != 0) {
         bool isCapture = decodeCapture(move);
         bool isPromotion = decodePromoted(move);
 
         if (!PVnode && !inCheck && movesSearched > 0 && !ttMoveMatch(move, hashMove) &&
-            depth <= 2 && isCapture && !isPromotion && moveScores[nmPly][count] < 0) {
+            depth <= 2 && isCapture && !isPromotion && picker.stage == stageBadCaptures) {
             continue;
         }
 
-        repetitionTable[repetitionIndex++] = board->zobristHash;
-        if (makeMove(board, move) == 0) {
-            repetitionIndex--;
-            takeBack(board, backup);
+        if (!isLegal(board, move, &checkInfo))
             continue;
-        }
+
+        thread->repetitionTable[thread->repetitionIndex++] = board->zobristHash;
+        makeMoveUnchecked(board, move, undo);
 
         ttPrefetch(board->zobristHash);
-        ply++;
+        thread->ply++;
         legalMoves++;
 
-        prevMovePiece[ply] = decodePiece(move);
-        prevMoveTarget[ply] = decodeTarget(move);
+        thread->prevMovePiece[thread->ply] = decodePiece(move);
+        thread->prevMoveTarget[thread->ply] = decodeTarget(move);
 
         int givesCheck = isBoardInCheck(board);
 
@@ -596,9 +722,9 @@ static inline int negamax(Board *board, int alpha, int beta, int depth) {
             if (depth <= 4 && !isCapture && !isPromotion) {
                 if (!givesCheck &&
                     movesSearched >= lmpThreshold[depth] + (improving ? depth : 0)) {
-                    ply--;
-                    repetitionIndex--;
-                    takeBack(board, backup);
+                    thread->ply--;
+                    thread->repetitionIndex--;
+                    unmakeMove(board, move, undo);
                     continue;
                 }
             }
@@ -606,42 +732,42 @@ static inline int negamax(Board *board, int alpha, int beta, int depth) {
             if (depth <= 3 && !isCapture && !isPromotion) {
                 if (!givesCheck &&
                     staticEval + futilityMargins[depth] + (improving ? 80 : 0) <= alpha) {
-                    ply--;
-                    repetitionIndex--;
-                    takeBack(board, backup);
+                    thread->ply--;
+                    thread->repetitionIndex--;
+                    unmakeMove(board, move, undo);
                     continue;
                 }
             }
         }
 
         if (movesSearched == 0) {
-            score = -negamax(board, -beta, -alpha, depth - 1);
+            score = -negamax(thread, -beta, -alpha, depth - 1);
         } else {
             if (movesSearched >= FullDepthMoves && depth >= ReductionLimit &&
                 !inCheck && !givesCheck && !isCapture && !isPromotion) {
                 int reduction = lmrReduction(depth, movesSearched, improving);
-                if (killerMoves[0][ply] == move || killerMoves[1][ply] == move)
+                if (thread->killerMoves[0][thread->ply] == move || thread->killerMoves[1][thread->ply] == move)
                     reduction--;
                 if (PVnode)
                     reduction--;
                 if (reduction < 1) reduction = 1;
-                score = -negamax(board, -alpha - 1, -alpha, depth - 1 - reduction);
+                score = -negamax(thread, -alpha - 1, -alpha, depth - 1 - reduction);
             } else {
                 score = alpha + 1;
             }
 
             if (score > alpha) {
-                score = -negamax(board, -alpha - 1, -alpha, depth - 1);
+                score = -negamax(thread, -alpha - 1, -alpha, depth - 1);
                 if ((score > alpha) && (score < beta)) {
-                    score = -negamax(board, -beta, -alpha, depth - 1);
+                    score = -negamax(thread, -beta, -alpha, depth - 1);
                 }
             }
         }
 
         movesSearched++;
-        ply--;
-        repetitionIndex--;
-        takeBack(board, backup);
+        thread->ply--;
+        thread->repetitionIndex--;
+        unmakeMove(board, move, undo);
 
         if (score > alpha) {
             hashFlag = hashExact;
@@ -650,26 +776,26 @@ static inline int negamax(Board *board, int alpha, int beta, int depth) {
 
             if (!isCapture) {
                 int bonus = depth * depth;
-                updateHistory(decodePiece(move), decodeTarget(move), bonus);
+                updateHistory(thread, decodePiece(move), decodeTarget(move), bonus);
             }
 
             alpha = score;
 
-            PrincipalVariationTable[ply][ply] = move;
-            for (int nextPly = ply + 1; nextPly < PrincipalVariationLength[ply + 1]; nextPly++) {
-                PrincipalVariationTable[ply][nextPly] = PrincipalVariationTable[ply + 1][nextPly];
+            thread->PrincipalVariationTable[ply][ply] = move;
+            for (int nextPly = ply + 1; nextPly < thread->PrincipalVariationLength[ply + 1]; nextPly++) {
+                thread->PrincipalVariationTable[ply][nextPly] = thread->PrincipalVariationTable[ply + 1][nextPly];
             }
-            PrincipalVariationLength[ply] = PrincipalVariationLength[ply + 1];
+            thread->PrincipalVariationLength[ply] = thread->PrincipalVariationLength[ply + 1];
 
             if (score >= beta) {
                 writeHashEntry(board, bestMove, beta, depth, hashBeta, ply, staticEval);
 
                 if (!isCapture) {
-                    killerMoves[1][ply] = killerMoves[0][ply];
-                    killerMoves[0][ply] = move;
+                    thread->killerMoves[1][ply] = thread->killerMoves[0][ply];
+                    thread->killerMoves[0][ply] = move;
 
                     if (ply > 0)
-                        counterMoves[prevMovePiece[ply - 1]][prevMoveTarget[ply - 1]] = move;
+                        thread->counterMoves[thread->prevMovePiece[ply - 1]][thread->prevMoveTarget[ply - 1]] = move;
                 }
 
                 return beta;
@@ -688,8 +814,65 @@ static inline int negamax(Board *board, int alpha, int beta, int depth) {
     return alpha;
 }
 
+// Copies the root position and game history (none if NULL) into a thread and clears its heuristics
+static inline void resetSearchThread(SearchThread *thread, const Board *board, const GameHistory *history) {
+    memcpy(&thread->board, board, sizeof(Board));
+    thread->repetitionIndex = history ? history->count : 0;
+    if (history) memcpy(thread->repetitionTable, history->hashes, sizeof(U64) * history->count);
+
+    thread->ply = 0;
+    thread->nodes = 0;
+    thread->followPrincipalVariation = 0;
+    thread->completedDepth = 0;
+    thread->pawnTable.probes = 0;
+    thread->pawnTable.hits = 0;
+
+    memset(thread->PrincipalVariationLength, 0, sizeof(thread->PrincipalVariationLength)); 
+    memset(thread->PrincipalVariationTable, 0, sizeof(thread->PrincipalVariationTable)); 
+    memset(thread->killerMoves, 0, sizeof(thread->killerMoves));
+    memset(thread->historyMoves, 0, sizeof(thread->historyMoves));
+    memset(thread->counterMoves, 0, sizeof(thread->counterMoves));
+    memset(thread->prevMovePiece, 0, sizeof(thread->prevMovePiece));
+    memset(thread->prevMoveTarget, 0, sizeof(thread->prevMoveTarget));
+    memset(thread->staticEvalHistory, 0, sizeof(thread->staticEvalHistory));
+}
+
+// Helper thread iterative deepening. Odd helpers search one ply deeper than the
+// nominal iteration so the threads desynchronise and fill the TT for each other.
+static inline void helperSearch(SearchThread *thread, int depth) {
+    int alpha = -INFINITY;
+    int beta = INFINITY;
+    int delta = 25;
+
+    for (int curDepth = 1; curDepth <= depth; curDepth++) {
+        if (searchParams->stop || searchParams->quit)
+            break;
 
-static inline void searchPosition(Board *board, SearchUCI *searchparams) {
+        int searchDepth = std::min(depth, curDepth + (thread->id & 1));
+        thread->followPrincipalVariation = 1;
+
+        int score = negamax(thread, alpha, beta, searchDepth);
+
+        if (searchParams->stop || searchParams->quit)
+            break;
+
+        if (score <= alpha || score >= beta) {
+            if (score <= alpha) alpha = score - delta;
+            else beta = score + delta;
+            delta *= 2;
+            if (delta > 500) { alpha = -INFINITY; beta = INFINITY; }
+            curDepth--;
+            continue;
+        }
+
+        alpha = score - 25;
+        beta = score + 25;
+        delta = 25;
+        thread->completedDepth = searchDepth;
+    }
+}
+
+static inline void searchPosition(Board *board, const GameHistory *history, SearchUCI *searchparams) {
 
     searchParams[0] = *searchparams;
     searchParams->stop = 0; // Reset stop flag
@@ -699,11 +882,19 @@ static inline void searchPosition(Board *board, SearchUCI *searchparams) {
 
     incrementTTGeneration();
 
-    ply = 0;
-    searchedNodes = 0;
-    followPrincipalVariation = 0;
-    scorePrincipalVariation = 0;
-    gameHistoryPly = repetitionIndex;
+    if (searchThreads == NULL)
+        initializeSearchThreads(1);
+
+    for (int i = 0; i < numSearchThreads; i++)
+        resetSearchThread(&searchThreads[i], board, history);
+
+    SearchThread *mainThread = &searchThreads[0];
+    gameHistoryPly = history->count;
+
+    std::vector<std::thread> helpers;
+    helpers.reserve(numSearchThreads - 1);
+    for (int i = 1; i < numSearchThreads; i++)
+        helpers.emplace_back(helperSearch, &searchThreads[i], depth);
 
     int alpha = -INFINITY;
     int beta = INFINITY;
@@ -711,16 +902,6 @@ static inline void searchPosition(Board *board, SearchUCI *searchparams) {
     int PrincipalVariationLastIteration[maxPly];
     int PrincipalVariationLastIterationLength = 0;
     int bestEvaluationPreviousIteration = 0;
-    
-    memset(PrincipalVariationLength, 0, sizeof(PrincipalVariationLength)); 
-    memset(PrincipalVariationTable, 0, sizeof(PrincipalVariationTable)); 
-    memset(killerMoves, 0, sizeof(killerMoves));
-    memset(historyMoves, 0, sizeof(historyMoves));
-    memset(counterMoves, 0, sizeof(counterMoves));
-    memset(prevMovePiece, 0, sizeof(prevMovePiece));
-    memset(prevMoveTarget, 0, sizeof(prevMoveTarget));
-    memset(staticEvalHistory, 0, sizeof(staticEvalHistory));
-    //clearTranspositionTable(); // Clear the transposition table before starting the search
 
     int delta = 25;
 
@@ -735,9 +916,9 @@ static inline void searchPosition(Board *board, SearchUCI *searchparams) {
             break;
         }
 
-        followPrincipalVariation = 1;
+        mainThread->followPrincipalVariation = 1;
 
-        int score = negamax(board, alpha, beta, curDepth);
+        int score = negamax(mainThread, alpha, beta, curDepth);
 
         if ((searchParams->stop || searchParams->quit) &&
             ((score <= alpha) || (score >= beta))) {
@@ -773,7 +954,9 @@ static inline void searchPosition(Board *board, SearchUCI *searchparams) {
         }
 
         bestEvaluationPreviousIteration = score;
+        mainThread->completedDepth = curDepth;
 
+        U64 searchedNodes = totalSearchedNodes();
         U64 elapsedMs = TIME_IN_MILLISECONDS - searchParams->startTime;
         U64 nps = elapsedMs > 0 ? (searchedNodes * 1000) / elapsedMs : 0;
 
@@ -785,49 +968,45 @@ static inline void searchPosition(Board *board, SearchUCI *searchparams) {
             std::cout << "info score cp " << score << " depth " << curDepth
                 << " nodes " << searchedNodes << " time " << elapsedMs << " nps " << nps << " hashfull " << hashfull() << " pv ";
 
-        for (int i = 0; i < PrincipalVariationLength[0]; i++) {
-            if (PrincipalVariationTable[0][i] == 0) break;
-            std::cout << moveToUCI(PrincipalVariationTable[0][i]) << " ";
-            PrincipalVariationLastIteration[i] = PrincipalVariationTable[0][i];
+        for (int i = 0; i < mainThread->PrincipalVariationLength[0]; i++) {
+            if (mainThread->PrincipalVariationTable[0][i] == 0) break;
+            std::cout << moveToUCI(mainThread->PrincipalVariationTable[0][i]) << " ";
+            PrincipalVariationLastIteration[i] = mainThread->PrincipalVariationTable[0][i];
         }
-        PrincipalVariationLastIterationLength = PrincipalVariationLength[0];
+        PrincipalVariationLastIterationLength = mainThread->PrincipalVariationLength[0];
         std::cout << std::endl;
     }
 
+    // Main thread is done (depth reached or time up): stop and collect the helpers
+    searchParams->stop = 1;
+    for (auto &helper : helpers) helper.join();
+
+    U64 pawnProbes = 0, pawnHits = 0;
+    for (int i = 0; i < numSearchThreads; i++) {
+        pawnProbes += searchThreads[i].pawnTable.probes;
+        pawnHits += searchThreads[i].pawnTable.hits;
+    }
+    if (pawnProbes > 0)
+        std::cout << "info string pawn hash hits " << pawnHits << "/" << pawnProbes
+                  << " (" << pawnHits * 100 / pawnProbes << "%)" << std::endl;
+
     if (PrincipalVariationLastIterationLength > 0 && PrincipalVariationLastIteration[0] != 0) {
         std::cout << "bestmove " << moveToUCI(PrincipalVariationLastIteration[0]) << std::endl;
     } else {
         int fallbackMove = 0;
 
         TTProbeResult fallbackProbe = probeHashEntry(board, -INFINITY, INFINITY, 0);
-        int ttMove = fallbackProbe.ttMove;
-        if (ttMove != 0) {
-            MoveList ttList;
-            generateMoves(board, &ttList);
-            for (int i = 0; i < ttList.count; i++) {
-                if (ttMoveMatch(ttList.moves[i], (uint16_t)ttMove)) {
-                    copyBoard(board);
-                    if (makeMove(board, ttList.moves[i]) != 0)
-                        fallbackMove = ttList.moves[i];
-                    takeBack(board, backup);
-                    break;
-                }
-            }
-        }
 
-        if (fallbackMove == 0) {
-            MoveList fallbackList;
-            generateMoves(board, &fallbackList);
-            scoreMoves(board, &fallbackList, 0, 0);
-            copyBoard(board);
-            for (int i = 0; i < fallbackList.count; i++) {
-                pickMove(&fallbackList, i, 0);
-                if (makeMove(board, fallbackList.moves[i]) == 0) {
-                    takeBack(board, backup);
-                    continue;
-                }
-                takeBack(board, backup);
-                fallbackMove = fallbackList.moves[i];
+        // First legal move in picker order, starting with the hash move
+        MovePicker picker;
+        resetSearchThread(mainThread, board, history);
+        initMovePicker(&picker, mainThread, fallbackProbe.ttMove, 0);
+        CheckInfo checkInfo;
+        computeCheckInfo(board, &checkInfo);
+        int move;
+        while ((move = nextMove(&picker)) != 0) {
+            if (isLegal(board, move, &checkInfo)) {
+                fallbackMove = move;
                 break;
             }
         }
@@ -1,20 +1,20 @@
-#include "evaluate.h"
+#include "search.h"
+#include "../utilities/dataset.h"
+#include "../utilities/threadpool.h"
 #include <fstream>
 #include <vector>
 #include <string>
 #include <cmath>
 #include <iostream>
+#include <iomanip>
 #include <sstream>
 #include <algorithm>
 #include <chrono>
 #include <thread>
 #include <atomic>
 #include <numeric>
-
-struct TunePosition {
-    std::string fen;
-    double result;
-};
+#include <unordered_map>
+#include <deque>
 
 struct TuneParam {
     int* ptr;
@@ -25,6 +25,37 @@ struct TuneParam {
     double gradient;
     double m;  // Adam first moment
     double v;  // Adam second moment
+    double value; // unrounded Adam position, *ptr holds the rounded one
+};
+
+// One parameter's weight in a traced position: the eval moves by weight per unit of the parameter
+struct TraceCoefficient {
+    int param;
+    float weight;
+};
+
+// A position reduced to its evaluation trace: eval = base + sum(param * weight)
+struct TracedPosition {
+    double result;
+    double base;
+    size_t begin; // coefficients[begin, end) in TraceSet
+    size_t end;
+};
+
+struct TraceSet {
+    std::vector<TracedPosition> positions;
+    std::vector<TraceCoefficient> coefficients;
+};
+
+// The traces turned around: for each parameter, the positions it appears in and its weight there
+struct ParamEntry {
+    uint32_t position;
+    float weight;
+};
+
+struct ParamIndex {
+    std::vector<size_t> offsets; // entries[offsets[i], offsets[i + 1]) belong to parameter i
+    std::vector<ParamEntry> entries;
 };
 
 double sigK = 1.13;
@@ -32,114 +63,270 @@ double REGULARIZATION = 0.0; // L2 regularization strength (set via CLI)
 std::vector<TuneParam>* globalParams = nullptr;
 int NUM_THREADS = std::max(1, (int)std::thread::hardware_concurrency() - 1);
 
-static double sigmoid(int eval) {
+static double sigmoid(double eval) {
     return 1.0 / (1.0 + pow(10.0, -sigK * eval / 400.0));
 }
 
-static double computeErrorChunk(const std::vector<TunePosition>& positions, int start, int end) {
-    double totalError = 0.0;
-    Board board;
-    for (int i = start; i < end; i++) {
-        parseFEN(&board, positions[i].fen);
-        int eval = evaluate(&board);
-        if (board.sideToMove == black) eval = -eval;
-        double predicted = sigmoid(eval);
-        double diff = positions[i].result - predicted;
-        totalError += diff * diff;
-    }
-    return totalError;
-}
+// Shared by every pass over the data; started in main once NUM_THREADS is known
+static ThreadPool tunerPool;
+#define tuneChunkSize 8192 // positions per pool task
 
 static void syncBlackPieceValues();
 
-static double computeError(const std::vector<TunePosition>& positions) {
-    int n = positions.size();
-    int chunkSize = n / NUM_THREADS;
-    std::vector<std::thread> threads;
-    std::vector<double> errors(NUM_THREADS, 0.0);
-
-    for (int t = 0; t < NUM_THREADS; t++) {
-        int start = t * chunkSize;
-        int end = (t == NUM_THREADS - 1) ? n : (t + 1) * chunkSize;
-        threads.emplace_back([&, t, start, end]() {
-            errors[t] = computeErrorChunk(positions, start, end);
-        });
+// Evaluates every position once with the trace switched on and keeps, per position, the
+// phase- and scale-blended weight of each registered parameter. Terms of parameters that
+// are not registered end up in base together with the non-linear parts of the eval.
+static TraceSet buildTraces(const PackedPosition* positions, size_t count, const std::vector<TuneParam>& params) {
+    syncBlackPieceValues();
+    std::unordered_map<const int*, int> paramIndex;
+    for (size_t i = 0; i < params.size(); i++) paramIndex[params[i].ptr] = i;
+    auto tempo = paramIndex.find(&tempoBonus);
+    int tempoIndex = tempo == paramIndex.end() ? -1 : tempo->second;
+
+    // One part per chunk so the traces come out in dataset order whoever builds them
+    std::vector<TraceSet> parts((count + tuneChunkSize - 1) / tuneChunkSize);
+    parallelFor(&tunerPool, count, tuneChunkSize, [&](int, size_t start, size_t end) {
+        TraceSet& part = parts[start / tuneChunkSize];
+        EvalTrace trace;
+        evalTrace = &trace;
+        std::vector<double> weights(params.size(), 0.0);
+        std::vector<int> touched;
+        Board board;
+        for (size_t i = start; i < end; i++) {
+            trace.terms.clear();
+            trace.drawn = false;
+            unpackPosition(&positions[i], &board);
+            int eval = evaluate(&board);
+            if (board.sideToMove == black) eval = -eval;
+
+            TracedPosition traced = {positionResult(&positions[i]), (double)eval, part.coefficients.size(), 0};
+            if (!trace.drawn) {
+                double scale = trace.scale / 100.0;
+                for (const auto& term : trace.terms) {
+                    auto it = paramIndex.find(term.param);
+                    if (it == paramIndex.end()) continue;
+                    double w = (term.mg * trace.phase + term.eg * (24 - trace.phase)) / 24.0 * scale;
+                    if (weights[it->second] == 0.0) touched.push_back(it->second);
+                    weights[it->second] += w;
+                }
+                if (tempoIndex >= 0) {
+                    if (weights[tempoIndex] == 0.0) touched.push_back(tempoIndex);
+                    weights[tempoIndex] += trace.tempo;
+                }
+                std::sort(touched.begin(), touched.end());
+                touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+                for (int index : touched) {
+                    if (weights[index] != 0.0) {
+                        part.coefficients.push_back({index, (float)weights[index]});
+                        traced.base -= *params[index].ptr * (double)(float)weights[index];
+                    }
+                    weights[index] = 0.0;
+                }
+                touched.clear();
+            }
+            traced.end = part.coefficients.size();
+            part.positions.push_back(traced);
+        }
+        evalTrace = NULL;
+    });
+
+    TraceSet traces;
+    for (auto& part : parts) {
+        size_t offset = traces.coefficients.size();
+        for (auto traced : part.positions) {
+            traced.begin += offset;
+            traced.end += offset;
+            traces.positions.push_back(traced);
+        }
+        traces.coefficients.insert(traces.coefficients.end(), part.coefficients.begin(), part.coefficients.end());
+    }
+    std::cout << "Traced " << traces.positions.size() << " positions, "
+              << traces.coefficients.size() << " coefficients ("
+              << (double)traces.coefficients.size() / std::max<size_t>(1, traces.positions.size())
+              << " per position)" << std::endl;
+    return traces;
+}
+
+static ParamIndex buildParamIndex(const TraceSet& traces, size_t numParams) {
+    ParamIndex index;
+    index.offsets.assign(numParams + 1, 0);
+    for (const auto& c : traces.coefficients) index.offsets[c.param + 1]++;
+    for (size_t i = 0; i < numParams; i++) index.offsets[i + 1] += index.offsets[i];
+
+    index.entries.resize(traces.coefficients.size());
+    std::vector<size_t> fill(index.offsets.begin(), index.offsets.end() - 1);
+    for (size_t j = 0; j < traces.positions.size(); j++) {
+        const TracedPosition& pos = traces.positions[j];
+        for (size_t c = pos.begin; c < pos.end; c++)
+            index.entries[fill[traces.coefficients[c].param]++] = {(uint32_t)j, traces.coefficients[c].weight};
     }
-    for (auto& th : threads) th.join();
+    return index;
+}
+
+static inline double tracedEval(const TraceSet& traces, const TracedPosition& pos, const std::vector<double>& values) {
+    double eval = pos.base;
+    for (size_t c = pos.begin; c < pos.end; c++)
+        eval += values[traces.coefficients[c].param] * traces.coefficients[c].weight;
+    return eval;
+}
+
+static std::vector<double> currentValues() {
+    std::vector<double> values(globalParams->size());
+    for (size_t i = 0; i < values.size(); i++) values[i] = *(*globalParams)[i].ptr;
+    return values;
+}
+
+// Mean squared error of the linear model, plus the L2 penalty, at any (unrounded) parameter
+// values. Fills gradient when it is given; either way it is one pass over the traces
+static double objective(const TraceSet& traces, const std::vector<double>& values, std::vector<double>* gradient) {
+    size_t n = traces.positions.size();
+    size_t numParams = values.size();
+    struct Partial {
+        double error;
+        std::vector<double> gradient;
+    };
 
-    double total = 0.0;
-    for (double e : errors) total += e;
-    double mse = total / n;
+    Partial total = parallelReduce(&tunerPool, n, tuneChunkSize, Partial{0.0, {}}, [&](size_t start, size_t end) {
+        Partial part{0.0, {}};
+        if (gradient) part.gradient.assign(numParams, 0.0);
+        for (size_t i = start; i < end; i++) {
+            const TracedPosition& pos = traces.positions[i];
+            double predicted = sigmoid(tracedEval(traces, pos, values));
+            double diff = pos.result - predicted;
+            part.error += diff * diff;
+            if (gradient) {
+                double factor = -2.0 * diff * predicted * (1.0 - predicted);
+                for (size_t c = pos.begin; c < pos.end; c++)
+                    part.gradient[traces.coefficients[c].param] += factor * traces.coefficients[c].weight;
+            }
+        }
+        return part;
+    }, [](Partial a, const Partial& b) {
+        a.error += b.error;
+        if (a.gradient.empty()) a.gradient = b.gradient;
+        else for (size_t i = 0; i < b.gradient.size(); i++) a.gradient[i] += b.gradient[i];
+        return a;
+    });
+    double mse = total.error / n;
+
+    // d/dθ (r - σ(E))² = -2 (r - σ) σ (1 - σ) K ln10 / 400 · w
+    if (gradient) {
+        double scale = sigK * std::log(10.0) / 400.0 / n;
+        gradient->assign(numParams, 0.0);
+        for (size_t i = 0; i < total.gradient.size(); i++) (*gradient)[i] = total.gradient[i] * scale;
+    }
 
     // L2 regularization: penalize deviation from starting values
     if (REGULARIZATION > 0.0 && globalParams) {
         double regPenalty = 0.0;
-        for (const auto& p : *globalParams) {
-            double diff = (*p.ptr - p.startVal);
+        for (size_t i = 0; i < numParams; i++) {
+            double diff = values[i] - (*globalParams)[i].startVal;
             regPenalty += diff * diff;
+            if (gradient) (*gradient)[i] += 2.0 * REGULARIZATION * diff / numParams;
         }
-        mse += REGULARIZATION * regPenalty / globalParams->size();
+        mse += REGULARIZATION * regPenalty / numParams;
     }
 
     return mse;
 }
 
-static double findOptimalK(const std::vector<TunePosition>& positions) {
-    double bestK = 1.0;
-    double bestError = 1e9;
-    for (double k = 0.5; k <= 2.0; k += 0.01) {
-        sigK = k;
-        double err = computeError(positions);
-        if (err < bestError) {
-            bestError = err;
-            bestK = k;
+static double computeError(const TraceSet& traces) {
+    return objective(traces, currentValues(), NULL);
+}
+
+// Newton's method on the error as a function of K alone; each iteration is one pass that
+// returns the error with its first and second derivative
+static double findOptimalK(const TraceSet& traces) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<double> values = currentValues();
+    size_t n = traces.positions.size();
+    std::vector<double> evals(n);
+    parallelFor(&tunerPool, n, tuneChunkSize, [&](int, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) evals[i] = tracedEval(traces, traces.positions[i], values);
+    });
+
+    struct Derivatives {
+        double error, first, second;
+    };
+    auto derivatives = [&](double K) {
+        Derivatives total = parallelReduce(&tunerPool, n, tuneChunkSize, Derivatives{0, 0, 0}, [&](size_t begin, size_t end) {
+            Derivatives part{0, 0, 0};
+            for (size_t i = begin; i < end; i++) {
+                double x = std::log(10.0) / 400.0 * evals[i];
+                double sigma = 1.0 / (1.0 + std::exp(-K * x));
+                double diff = traces.positions[i].result - sigma;
+                double dSigma = sigma * (1.0 - sigma) * x;                // dσ/dK
+                double d2Sigma = dSigma * (1.0 - 2.0 * sigma) * x;        // d²σ/dK²
+                part.error += diff * diff;
+                part.first += -2.0 * diff * dSigma;
+                part.second += 2.0 * (dSigma * dSigma - diff * d2Sigma);
+            }
+            return part;
+        }, [](Derivatives a, const Derivatives& b) {
+            return Derivatives{a.error + b.error, a.first + b.first, a.second + b.second};
+        });
+        return Derivatives{total.error / n, total.first / n, total.second / n};
+    };
+
+    double K = 1.0;
+    Derivatives d = derivatives(K);
+    int iterations = 0;
+    for (; iterations < 50; iterations++) {
+        // Fall back to a fixed-size downhill step where the error is not convex in K
+        double step = d.second > 0 ? -d.first / d.second : (d.first > 0 ? -0.1 : 0.1);
+        step = std::max(-0.5, std::min(0.5, step));
+        double nextK = std::max(0.05, K + step);
+        Derivatives next = derivatives(nextK);
+        while (next.error > d.error && std::abs(nextK - K) > 1e-9) {
+            nextK = (K + nextK) / 2;
+            next = derivatives(nextK);
         }
+        bool done = std::abs(nextK - K) < 1e-6;
+        K = nextK;
+        d = next;
+        if (done) break;
     }
-    sigK = bestK;
-    std::cout << "Optimal K: " << bestK << " (error: " << bestError << ")" << std::endl;
-    return bestK;
+
+    sigK = K;
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Optimal K: " << K << " (error: " << computeError(traces) << ", "
+              << iterations + 1 << " Newton iterations, " << secs << "s)" << std::endl;
+    return K;
 }
 
-static std::vector<TunePosition> loadPositions(const std::string& filename) {
-    std::vector<TunePosition> positions;
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "Cannot open " << filename << std::endl;
-        return positions;
-    }
-
-    std::string line;
-    while (std::getline(file, line)) {
-        if (line.empty()) continue;
-
-        size_t bracketOpen = line.find('[');
-        size_t bracketClose = line.find(']');
-        size_t semicolon = line.find(';');
-
-        TunePosition pos;
-        if (bracketOpen != std::string::npos && bracketClose != std::string::npos) {
-            pos.fen = line.substr(0, bracketOpen);
-            while (!pos.fen.empty() && pos.fen.back() == ' ') pos.fen.pop_back();
-            std::string resultStr = line.substr(bracketOpen + 1, bracketClose - bracketOpen - 1);
-            if (resultStr == "1.0" || resultStr == "1-0") pos.result = 1.0;
-            else if (resultStr == "0.0" || resultStr == "0-1") pos.result = 0.0;
-            else pos.result = 0.5;
-        } else if (semicolon != std::string::npos) {
-            pos.fen = line.substr(0, semicolon);
-            while (!pos.fen.empty() && pos.fen.back() == ' ') pos.fen.pop_back();
-            std::string resultStr = line.substr(semicolon + 1);
-            while (!resultStr.empty() && resultStr.front() == ' ') resultStr.erase(resultStr.begin());
-            if (resultStr == "1-0" || resultStr == "1.0") pos.result = 1.0;
-            else if (resultStr == "0-1" || resultStr == "0.0") pos.result = 0.0;
-            else pos.result = 0.5;
-        } else {
-            continue;
+// Maps a packed dataset, or packs a text one in memory; either way tuning works on PackedPositions
+static bool loadPositions(const std::string& filename, PackedDataset& dataset, std::vector<PackedPosition>& packed) {
+    if (isDatasetFile(filename)) {
+        if (!openDataset(&dataset, filename)) {
+            std::cerr << "Cannot map " << filename << std::endl;
+            return false;
         }
-        positions.push_back(pos);
+    } else {
+        packed = readTextDataset(filename);
+        dataset.positions = packed.data();
+        dataset.count = packed.size();
+        dataset.mapping = NULL;
+        dataset.mappedBytes = 0;
     }
+    std::cout << "Loaded " << dataset.count << " positions" << std::endl;
+    return dataset.count > 0;
+}
 
-    std::cout << "Loaded " << positions.size() << " positions" << std::endl;
-    return positions;
+static int convertPositions(const std::string& input, const std::string& output) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<PackedPosition> packed = readTextDataset(input);
+    if (packed.empty()) {
+        std::cerr << "No positions read from " << input << std::endl;
+        return 1;
+    }
+    if (!writeDataset(output, packed)) {
+        std::cerr << "Cannot write " << output << std::endl;
+        return 1;
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Wrote " << packed.size() << " positions (" << packed.size() * sizeof(PackedPosition) / 1024
+              << " KB) to " << output << " in " << secs << "s" << std::endl;
+    return 0;
 }
 
 static void registerParams(std::vector<TuneParam>& params) {
@@ -208,53 +395,49 @@ static void registerParams(std::vector<TuneParam>& params) {
     for (int i = 2; i <= 14; i++) {
         reg(&kingSafetyTable[i], "kingSafety_" + std::to_string(i), 0, 500);
     }
-}
-
-static void computeGradients(std::vector<TunePosition>& positions, std::vector<TuneParam>& params, int step) {
-    syncBlackPieceValues();
-    double baseError = computeError(positions);
-
-    int numParams = params.size();
-
-    for (int i = 0; i < numParams; i++) {
-        int original = *params[i].ptr;
-        int newVal = std::min(original + step, params[i].maxVal);
-        if (newVal == original) newVal = std::max(original - step, params[i].minVal);
 
-        *params[i].ptr = newVal;
-        syncBlackPieceValues();
-        double newError = computeError(positions);
-        *params[i].ptr = original;
-        syncBlackPieceValues();
-
-        params[i].gradient = (newError - baseError) / (newVal - original);
+    // Piece-square tables, white's point of view; pawns never stand on the first or last rank
+    static const char* pieceNames[6] = {"pawn", "knight", "bishop", "rook", "queen", "king"};
+    int (*tables[6])[64] = {pawnSquareTable, knightSquareTable, bishopSquareTable, rookSquareTable, queenSquareTable, kingSquareTable};
+    for (int piece = 0; piece < 6; piece++) {
+        for (int stage = MG; stage <= EG; stage++) {
+            for (int square = 0; square < 64; square++) {
+                if (piece == 0 && (square < a2 || square > h7)) continue;
+                int* entry = &tables[piece][stage][square];
+                reg(entry, std::string(pieceNames[piece]) + "SquareTable_" + (stage == MG ? "MG_" : "EG_") + indexToSquare[square],
+                    *entry - 100, *entry + 100);
+            }
+        }
     }
 }
 
-static void adamOptimize(std::vector<TunePosition>& positions, std::vector<TuneParam>& params) {
+static void computeGradients(const TraceSet& traces, std::vector<TuneParam>& params) {
+    std::vector<double> gradient;
+    objective(traces, currentValues(), &gradient);
+    for (size_t i = 0; i < params.size(); i++) params[i].gradient = gradient[i];
+}
+
+static void adamOptimize(const TraceSet& traces, std::vector<TuneParam>& params) {
     const double alpha = 2.0;    // Learning rate (in integer param units)
     const double beta1 = 0.9;
     const double beta2 = 0.999;
     const double epsilon = 1e-8;
-    const int maxEpochs = 200;
-    const int patienceLimit = 10;
+    const int maxEpochs = 2000;  // epochs are a single pass over the traces
+    const int patienceLimit = 50;
 
-    double bestError = computeError(positions);
+    double bestError = computeError(traces);
     std::cout << "Initial error: " << bestError << std::endl;
 
     std::vector<int> bestValues(params.size());
     for (size_t i = 0; i < params.size(); i++) bestValues[i] = *params[i].ptr;
 
     int patience = 0;
-    int step = 3;
+    for (auto& p : params) p.value = *p.ptr;
 
     for (int epoch = 1; epoch <= maxEpochs; epoch++) {
         auto start = std::chrono::steady_clock::now();
 
-        if (epoch > 50) step = 2;
-        if (epoch > 100) step = 1;
-
-        computeGradients(positions, params, step);
+        computeGradients(traces, params);
 
         int paramsChanged = 0;
         for (size_t i = 0; i < params.size(); i++) {
@@ -268,23 +451,16 @@ static void adamOptimize(std::vector<TunePosition>& positions, std::vector<TuneP
 
             double update = -alpha * mHat / (sqrt(vHat) + epsilon);
 
-            int intUpdate = (int)round(update);
-            if (intUpdate == 0 && std::abs(update) > 0.3) {
-                intUpdate = (update > 0) ? 1 : -1;
-            }
-
-            if (intUpdate != 0) {
-                int newVal = *p.ptr + intUpdate;
-                newVal = std::max(p.minVal, std::min(p.maxVal, newVal));
-                if (newVal != *p.ptr) {
-                    *p.ptr = newVal;
-                    paramsChanged++;
-                }
+            // Adam moves the unrounded value; the eval only ever sees the rounded one
+            p.value = std::max((double)p.minVal, std::min((double)p.maxVal, p.value + update));
+            int newVal = (int)round(p.value);
+            if (newVal != *p.ptr) {
+                *p.ptr = newVal;
+                paramsChanged++;
             }
         }
 
-        syncBlackPieceValues();
-        double currentError = computeError(positions);
+        double currentError = computeError(traces);
 
         if (currentError < bestError) {
             bestError = currentError;
@@ -298,15 +474,15 @@ static void adamOptimize(std::vector<TunePosition>& positions, std::vector<TuneP
         double secs = std::chrono::duration<double>(end - start).count();
         std::cout << "Epoch " << epoch << " (" << secs << "s): error=" << currentError
                   << " best=" << bestError << " changed=" << paramsChanged
-                  << " step=" << step << " patience=" << patience << std::endl;
+                  << " patience=" << patience << " positions/s=" << 2 * traces.positions.size() / secs << std::endl;
 
         if (patience >= patienceLimit) {
             std::cout << "Early stopping: no improvement for " << patienceLimit << " epochs" << std::endl;
             break;
         }
 
-        if (paramsChanged == 0 && step == 1) {
-            std::cout << "Converged: no parameters changed at minimum step size" << std::endl;
+        if (paramsChanged == 0 && epoch > patienceLimit) {
+            std::cout << "Converged: no parameter changed this epoch" << std::endl;
             break;
         }
     }
@@ -315,9 +491,294 @@ static void adamOptimize(std::vector<TunePosition>& positions, std::vector<TuneP
     std::cout << "\nFinal error: " << bestError << std::endl;
 }
 
-static void localSearch(std::vector<TunePosition>& positions, std::vector<TuneParam>& params) {
-    syncBlackPieceValues();
-    double bestError = computeError(positions);
+static double dot(const std::vector<double>& a, const std::vector<double>& b) {
+    double sum = 0.0;
+    for (size_t i = 0; i < a.size(); i++) sum += a[i] * b[i];
+    return sum;
+}
+
+static void clampToBounds(const std::vector<TuneParam>& params, std::vector<double>& values) {
+    for (size_t i = 0; i < values.size(); i++)
+        values[i] = std::max((double)params[i].minVal, std::min((double)params[i].maxVal, values[i]));
+}
+
+// Gradient with the components of parameters that sit on a bound and are pushed against it
+// zeroed; those parameters are held fixed for the step
+static std::vector<double> projectedGradient(const std::vector<TuneParam>& params, const std::vector<double>& x,
+                                             const std::vector<double>& g) {
+    std::vector<double> projected = g;
+    for (size_t i = 0; i < x.size(); i++) {
+        if ((x[i] <= params[i].minVal && g[i] > 0) || (x[i] >= params[i].maxVal && g[i] < 0))
+            projected[i] = 0.0;
+    }
+    return projected;
+}
+
+// Backtracking (Armijo) line search along direction, projected onto the parameter bounds.
+// Returns the accepted step or 0 if no step decreased the error
+static double lineSearch(const TraceSet& traces, const std::vector<TuneParam>& params,
+                         const std::vector<double>& x, double f, const std::vector<double>& g,
+                         const std::vector<double>& direction, double step,
+                         std::vector<double>& xNew, double& fNew, std::vector<double>& gNew, int& passes) {
+    for (int tries = 0; tries < 30; tries++, step *= 0.5) {
+        for (size_t i = 0; i < x.size(); i++) xNew[i] = x[i] + step * direction[i];
+        clampToBounds(params, xNew);
+        double decrease = 0.0;
+        for (size_t i = 0; i < x.size(); i++) decrease += g[i] * (xNew[i] - x[i]);
+        if (decrease >= 0.0) continue;
+        fNew = objective(traces, xNew, &gNew);
+        passes++;
+        if (fNew <= f + 1e-4 * decrease) return step;
+    }
+    return 0.0;
+}
+
+// Rounds the continuous solution into the eval parameters and reports the rounding cost
+static void applyRounded(const TraceSet& traces, std::vector<TuneParam>& params, const std::vector<double>& x, double f) {
+    for (size_t i = 0; i < params.size(); i++) *params[i].ptr = (int)round(x[i]);
+    std::cout << "\nFinal error: " << computeError(traces) << " (unrounded " << f << ")" << std::endl;
+}
+
+static void logEpoch(int epoch, double secs, double f, double previous, const std::vector<double>& g,
+                     double step, int passes, size_t positions) {
+    double gradNorm = std::sqrt(dot(g, g)); // of the projected gradient
+    std::cout << "Epoch " << epoch << " (" << secs << "s): error=" << f << " improvement=" << previous - f
+              << " |grad|=" << gradNorm << " step=" << step << " passes=" << passes
+              << " positions/s=" << (secs > 0 ? passes * positions / secs : 0.0) << std::endl;
+}
+
+// Limited-memory BFGS on the unrounded parameters, with the two-loop recursion for the
+// search direction and a projected backtracking line search
+static void lbfgsOptimize(const TraceSet& traces, std::vector<TuneParam>& params) {
+    const int memory = 10;
+    const int maxEpochs = 500;
+    const double tolerance = 1e-10; // stop once an epoch improves the error by less than this
+    size_t numParams = params.size();
+    size_t n = traces.positions.size();
+
+    std::vector<double> x(numParams), g, xNew(numParams), gNew, direction(numParams);
+    for (size_t i = 0; i < numParams; i++) x[i] = *params[i].ptr;
+    double f = objective(traces, x, &g);
+    std::cout << "Initial error: " << f << std::endl;
+
+    std::deque<std::vector<double>> sHistory, yHistory;
+    std::deque<double> rhoHistory;
+    std::vector<double> alphas(memory);
+
+    for (int epoch = 1; epoch <= maxEpochs; epoch++) {
+        auto start = std::chrono::steady_clock::now();
+        int passes = 0;
+
+        std::vector<double> pg = projectedGradient(params, x, g);
+        std::vector<double> q = pg;
+        for (int k = (int)sHistory.size() - 1; k >= 0; k--) {
+            alphas[k] = rhoHistory[k] * dot(sHistory[k], q);
+            for (size_t i = 0; i < numParams; i++) q[i] -= alphas[k] * yHistory[k][i];
+        }
+        double gamma;
+        if (sHistory.empty()) {
+            // First step: move the most sensitive parameter by about one unit
+            double gMax = 0.0;
+            for (double gi : pg) gMax = std::max(gMax, std::abs(gi));
+            gamma = gMax > 0 ? 1.0 / gMax : 1.0;
+        } else {
+            gamma = dot(sHistory.back(), yHistory.back()) / dot(yHistory.back(), yHistory.back());
+        }
+        for (size_t i = 0; i < numParams; i++) q[i] *= gamma;
+        for (size_t k = 0; k < sHistory.size(); k++) {
+            double beta = rhoHistory[k] * dot(yHistory[k], q);
+            for (size_t i = 0; i < numParams; i++) q[i] += sHistory[k][i] * (alphas[k] - beta);
+        }
+        for (size_t i = 0; i < numParams; i++) direction[i] = pg[i] == 0.0 ? 0.0 : -q[i];
+
+        double fNew = f;
+        double step = lineSearch(traces, params, x, f, g, direction, 1.0, xNew, fNew, gNew, passes);
+        if (step == 0.0) {
+            if (sHistory.empty()) {
+                std::cout << "Converged: no descent step found" << std::endl;
+                break;
+            }
+            // Stale curvature pairs, restart from a scaled gradient step
+            sHistory.clear();
+            yHistory.clear();
+            rhoHistory.clear();
+            continue;
+        }
+
+        std::vector<double> pgNew = projectedGradient(params, xNew, gNew);
+        std::vector<double> sk(numParams), yk(numParams);
+        for (size_t i = 0; i < numParams; i++) {
+            sk[i] = xNew[i] - x[i];
+            yk[i] = pgNew[i] - pg[i];
+        }
+        double sy = dot(sk, yk);
+        if (sy > 1e-12 * dot(yk, yk)) {
+            sHistory.push_back(sk);
+            yHistory.push_back(yk);
+            rhoHistory.push_back(1.0 / sy);
+            if ((int)sHistory.size() > memory) {
+                sHistory.pop_front();
+                yHistory.pop_front();
+                rhoHistory.pop_front();
+            }
+        }
+
+        double previous = f;
+        x = xNew;
+        f = fNew;
+        g = gNew;
+
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        logEpoch(epoch, secs, f, previous, pgNew, step, passes, n);
+
+        if (previous - f < tolerance) {
+            std::cout << "Converged: improvement below " << tolerance << std::endl;
+            break;
+        }
+    }
+
+    applyRounded(traces, params, x, f);
+}
+
+// Cholesky solve of the dense symmetric positive definite system a * x = b (a is overwritten)
+static bool choleskySolve(std::vector<double>& a, std::vector<double>& b, size_t size) {
+    for (size_t j = 0; j < size; j++) {
+        double diagonal = a[j * size + j];
+        for (size_t k = 0; k < j; k++) diagonal -= a[j * size + k] * a[j * size + k];
+        if (diagonal <= 0.0) return false;
+        diagonal = std::sqrt(diagonal);
+        a[j * size + j] = diagonal;
+        for (size_t i = j + 1; i < size; i++) {
+            double sum = a[i * size + j];
+            for (size_t k = 0; k < j; k++) sum -= a[i * size + k] * a[j * size + k];
+            a[i * size + j] = sum / diagonal;
+        }
+    }
+    for (size_t i = 0; i < size; i++) {
+        double sum = b[i];
+        for (size_t k = 0; k < i; k++) sum -= a[i * size + k] * b[k];
+        b[i] = sum / a[i * size + i];
+    }
+    for (size_t i = size; i-- > 0;) {
+        double sum = b[i];
+        for (size_t k = i + 1; k < size; k++) sum -= a[k * size + i] * b[k];
+        b[i] = sum / a[i * size + i];
+    }
+    return true;
+}
+
+// Gauss-Newton with Levenberg-Marquardt damping: the error is a sum of squared residuals
+// r - σ(E), so J^T J of those residuals is a good, positive semi-definite Hessian estimate
+static void gaussNewtonOptimize(const TraceSet& traces, std::vector<TuneParam>& params) {
+    const int maxEpochs = 100;
+    const double tolerance = 1e-10;
+    size_t numParams = params.size();
+    size_t n = traces.positions.size();
+    double lambda = 1e-3;
+
+    std::vector<double> x(numParams), g, xNew(numParams), gNew;
+    for (size_t i = 0; i < numParams; i++) x[i] = *params[i].ptr;
+    double f = objective(traces, x, &g);
+    std::cout << "Initial error: " << f << std::endl;
+
+    // One dense accumulator per pool worker; positions only touch the rows of their own terms
+    std::vector<std::vector<double>> hessians(tunerPool.size);
+
+    for (int epoch = 1; epoch <= maxEpochs; epoch++) {
+        auto start = std::chrono::steady_clock::now();
+        int passes = 0;
+
+        for (auto& h : hessians) h.assign(numParams * numParams, 0.0);
+        parallelFor(&tunerPool, n, tuneChunkSize, [&](int worker, size_t begin, size_t end) {
+            std::vector<double>& h = hessians[worker];
+            for (size_t j = begin; j < end; j++) {
+                const TracedPosition& pos = traces.positions[j];
+                double predicted = sigmoid(tracedEval(traces, pos, x));
+                double slope = predicted * (1.0 - predicted);
+                double weight = slope * slope;
+                for (size_t a = pos.begin; a < pos.end; a++) {
+                    size_t row = traces.coefficients[a].param * numParams;
+                    double wa = weight * traces.coefficients[a].weight;
+                    for (size_t b = pos.begin; b < pos.end; b++)
+                        h[row + traces.coefficients[b].param] += wa * traces.coefficients[b].weight;
+                }
+            }
+        });
+        passes++;
+
+        double scale = sigK * std::log(10.0) / 400.0;
+        scale = 2.0 * scale * scale / n;
+        std::vector<double> hessian(numParams * numParams, 0.0);
+        for (const auto& h : hessians)
+            for (size_t i = 0; i < h.size(); i++) hessian[i] += h[i] * scale;
+        if (REGULARIZATION > 0.0)
+            for (size_t i = 0; i < numParams; i++) hessian[i * numParams + i] += 2.0 * REGULARIZATION / numParams;
+
+        // Damped system (H + λ diag(H)) δ = -g over the free parameters. λ grows until the
+        // system factorizes and the step decreases the error, and shrinks after full steps
+        std::vector<double> pg = projectedGradient(params, x, g);
+        double fNew = f, step = 0.0;
+        for (int attempt = 0; attempt < 12 && step == 0.0; attempt++) {
+            std::vector<double> system = hessian;
+            std::vector<double> direction(numParams);
+            for (size_t i = 0; i < numParams; i++) {
+                if (pg[i] == 0.0) {
+                    for (size_t j = 0; j < numParams; j++) system[i * numParams + j] = system[j * numParams + i] = 0.0;
+                    system[i * numParams + i] = 1.0;
+                } else {
+                    system[i * numParams + i] += lambda * hessian[i * numParams + i] + 1e-12;
+                }
+                direction[i] = -pg[i];
+            }
+            if (choleskySolve(system, direction, numParams))
+                step = lineSearch(traces, params, x, f, g, direction, 1.0, xNew, fNew, gNew, passes);
+            if (step == 0.0) lambda *= 10.0;
+        }
+        if (step == 0.0) {
+            std::cout << "Converged: no descent step found" << std::endl;
+            break;
+        }
+        lambda = step == 1.0 ? std::max(1e-9, lambda / 3.0) : lambda * 4.0;
+
+        double previous = f;
+        x = xNew;
+        f = fNew;
+        g = gNew;
+
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        logEpoch(epoch, secs, f, previous, projectedGradient(params, x, g), step, passes, n);
+        std::cout << "  lambda=" << lambda << std::endl;
+
+        if (previous - f < tolerance) {
+            std::cout << "Converged: improvement below " << tolerance << std::endl;
+            break;
+        }
+    }
+
+    applyRounded(traces, params, x, f);
+}
+
+// Tries ±1 on every parameter. Each position's eval is kept, so a trial only re-scores the
+// positions the parameter appears in and adjusts the summed error by the difference.
+static void localSearch(const TraceSet& traces, std::vector<TuneParam>& params) {
+    size_t n = traces.positions.size();
+    ParamIndex index = buildParamIndex(traces, params.size());
+
+    std::vector<double> evals(n);
+    auto rescoreAll = [&]() {
+        std::vector<double> values = currentValues();
+        parallelFor(&tunerPool, n, tuneChunkSize, [&](int, size_t start, size_t end) {
+            for (size_t j = start; j < end; j++) evals[j] = tracedEval(traces, traces.positions[j], values);
+        });
+    };
+
+    auto regularization = [&](const TuneParam& p, int value) {
+        double diff = value - p.startVal;
+        return REGULARIZATION > 0.0 ? REGULARIZATION * diff * diff / params.size() : 0.0;
+    };
+
+    rescoreAll();
+    double bestError = computeError(traces);
     std::cout << "\nLocal search refinement from error: " << bestError << std::endl;
 
     bool improved = true;
@@ -327,39 +788,49 @@ static void localSearch(std::vector<TunePosition>& positions, std::vector<TunePa
         improved = false;
         epoch++;
         auto start = std::chrono::steady_clock::now();
+        size_t rescored = 0;
 
-        for (auto& p : params) {
+        for (size_t i = 0; i < params.size(); i++) {
+            auto& p = params[i];
             int original = *p.ptr;
-
-            if (original + 1 <= p.maxVal) {
-                *p.ptr = original + 1;
-                syncBlackPieceValues();
-                double err = computeError(positions);
+            const ParamEntry* entries = index.entries.data() + index.offsets[i];
+            size_t count = index.offsets[i + 1] - index.offsets[i];
+
+            for (int delta : {1, -1}) {
+                if (original + delta < p.minVal || original + delta > p.maxVal) continue;
+
+                double change = parallelReduce(&tunerPool, count, tuneChunkSize, 0.0, [&](size_t begin, size_t end) {
+                    double sum = 0.0;
+                    for (size_t e = begin; e < end; e++) {
+                        const ParamEntry& entry = entries[e];
+                        double result = traces.positions[entry.position].result;
+                        double before = result - sigmoid(evals[entry.position]);
+                        double after = result - sigmoid(evals[entry.position] + delta * entry.weight);
+                        sum += after * after - before * before;
+                    }
+                    return sum;
+                }, [](double a, double b) { return a + b; });
+                rescored += count;
+
+                double err = bestError + change / n + regularization(p, original + delta) - regularization(p, original);
                 if (err < bestError) {
+                    for (size_t e = 0; e < count; e++) evals[entries[e].position] += delta * entries[e].weight;
+                    *p.ptr = original + delta;
                     bestError = err;
                     improved = true;
-                    continue;
+                    break;
                 }
             }
-
-            if (original - 1 >= p.minVal) {
-                *p.ptr = original - 1;
-                syncBlackPieceValues();
-                double err = computeError(positions);
-                if (err < bestError) {
-                    bestError = err;
-                    improved = true;
-                    continue;
-                }
-            }
-
-            *p.ptr = original;
-            syncBlackPieceValues();
         }
 
+        // Resync with a full pass so the running evals and error do not drift
+        rescoreAll();
+        bestError = computeError(traces);
+
         auto end = std::chrono::steady_clock::now();
         double secs = std::chrono::duration<double>(end - start).count();
-        std::cout << "  Refine epoch " << epoch << " (" << secs << "s), error: " << bestError << std::endl;
+        std::cout << "  Refine epoch " << epoch << " (" << secs << "s), error: " << bestError
+                  << ", rescored " << rescored << " positions (" << (double)rescored / n << " full passes)" << std::endl;
     }
 
     std::cout << "Local search complete after " << epoch << " epochs, final error: " << bestError << std::endl;
@@ -424,41 +895,221 @@ static void printResults(const std::vector<TuneParam>& params) {
         if (i % 10 == 9) std::cout << std::endl << "  ";
     }
     std::cout << std::endl << "};" << std::endl;
+
+    static const char* tableNames[6] = {"pawn", "knight", "bishop", "rook", "queen", "king"};
+    for (int piece = 0; piece < 6; piece++) {
+        std::cout << tableNames[piece] << "SquareTable[2][64] = {" << std::endl;
+        for (int stage = MG; stage <= EG; stage++) {
+            std::cout << "    {" << std::endl;
+            for (int rank = 0; rank < 8; rank++) {
+                std::cout << "      ";
+                for (int file = 0; file < 8; file++) {
+                    int value = pieceSquareTables[piece][stage][rank * 8 + file];
+                    std::cout << std::setw(4) << value << (rank * 8 + file < 63 ? "," : "");
+                }
+                std::cout << std::endl;
+            }
+            std::cout << (stage == MG ? "    }," : "    }") << std::endl;
+        }
+        std::cout << "};" << std::endl;
+    }
+}
+
+// Replaces a position by the leaf of its quiescence search. qsearch does not keep a PV, so it
+// is walked afterwards the way qsearch itself searches each node: the same move picker
+// (hash move and winning captures), the same delta pruning against the best score so far and
+// the real qsearch depth, following the best capture while it beats standing pat. Positions
+// in check, with mate scores or whose leaf is in check are dropped; kept ones carry the root
+// qsearch score from white's point of view in PackedPosition::score.
+enum ResolveOutcome { resolveKept, resolveInCheck, resolveMate, resolveLeafInCheck };
+
+static ResolveOutcome resolvePosition(SearchThread *thread, const PackedPosition *packed, PackedPosition *resolved, int *leafPly) {
+    Board root;
+    unpackPosition(packed, &root);
+    resetSearchThread(thread, &root, NULL);
+    Board *board = &thread->board;
+
+    if (isBoardInCheck(board)) return resolveInCheck;
+    int score = quiescenceSearch(thread, -INFINITY, INFINITY);
+    if (std::abs(score) >= MATESCORE) return resolveMate;
+
+    for (int qDepth = 0; thread->ply < maxPly - 1; qDepth++) {
+        if (isBoardInCheck(board)) return resolveLeafInCheck;
+
+        int eval = evaluate(board, &thread->pawnTable);
+        int best = eval;
+        int bestMove = 0;
+        MovePicker picker;
+        initMovePicker(&picker, thread, probeHashEntry(board, best, INFINITY, 0, thread->ply).ttMove, 1);
+        CheckInfo checkInfo;
+        computeCheckInfo(board, &checkInfo);
+        StateInfo *undo = &thread->undoStack[thread->ply];
+        int move;
+        while ((move = nextMove(&picker)) != 0) {
+            if (!decodeCapture(move) || eval + deltaCaptureGain(board, move) + 200 < best) continue;
+            if (!isLegal(board, move, &checkInfo)) continue;
+            makeMoveUnchecked(board, move, undo);
+            thread->ply++;
+            thread->repetitionTable[thread->repetitionIndex++] = board->zobristHash;
+            int childScore = -quiescenceSearch(thread, -INFINITY, -best, qDepth + 1);
+            thread->ply--;
+            thread->repetitionIndex--;
+            unmakeMove(board, move, undo);
+            if (childScore > best) {
+                best = childScore;
+                bestMove = move;
+            }
+        }
+        if (!bestMove) break;
+
+        makeMoveUnchecked(board, bestMove, undo);
+        thread->ply++;
+        thread->repetitionTable[thread->repetitionIndex++] = board->zobristHash;
+    }
+
+    int whiteScore = root.sideToMove == white ? score : -score;
+    *resolved = packPosition(board, positionResult(packed), whiteScore, packed->fullMoveNumber + thread->ply / 2);
+    *leafPly = thread->ply;
+    return resolveKept;
+}
+
+static int resolvePositions(const std::string& input, const std::string& output) {
+    auto start = std::chrono::steady_clock::now();
+    PackedDataset dataset;
+    std::vector<PackedPosition> packed;
+    if (!loadPositions(input, dataset, packed)) {
+        std::cerr << "No positions loaded." << std::endl;
+        return 1;
+    }
+
+    // qsearch probes the transposition table, so it needs one even though nothing is stored
+    initializeTranspositionSize(1);
+    std::unique_ptr<SearchThread[]> threads(new SearchThread[tunerPool.size]);
+    for (int i = 0; i < tunerPool.size; i++) {
+        threads[i].id = i + 1; // id 0 would poll stdin for UCI commands
+        memset(&threads[i].pawnTable, 0, sizeof(PawnHashTable));
+    }
+
+    struct ResolvedChunk {
+        std::vector<PackedPosition> positions;
+        size_t dropped[4] = {0, 0, 0, 0};
+        size_t moved = 0;
+        size_t leafPlies = 0;
+    };
+    size_t count = dataset.count;
+    std::vector<ResolvedChunk> chunks((count + tuneChunkSize - 1) / tuneChunkSize);
+    parallelFor(&tunerPool, count, tuneChunkSize, [&](int worker, size_t begin, size_t end) {
+        ResolvedChunk& chunk = chunks[begin / tuneChunkSize];
+        for (size_t i = begin; i < end; i++) {
+            PackedPosition resolved;
+            int leafPly = 0;
+            ResolveOutcome outcome = resolvePosition(&threads[worker], &dataset.positions[i], &resolved, &leafPly);
+            if (outcome != resolveKept) {
+                chunk.dropped[outcome]++;
+                continue;
+            }
+            chunk.positions.push_back(resolved);
+            chunk.moved += leafPly > 0;
+            chunk.leafPlies += leafPly;
+        }
+    });
+
+    DatasetWriter writer;
+    if (!openDatasetWriter(&writer, output)) {
+        std::cerr << "Cannot write " << output << std::endl;
+        return 1;
+    }
+    size_t dropped[4] = {0, 0, 0, 0}, moved = 0, leafPlies = 0;
+    for (const auto& chunk : chunks) {
+        writePositions(&writer, chunk.positions.data(), chunk.positions.size());
+        for (int i = 0; i < 4; i++) dropped[i] += chunk.dropped[i];
+        moved += chunk.moved;
+        leafPlies += chunk.leafPlies;
+    }
+    size_t kept = writer.count;
+    if (!closeDatasetWriter(&writer)) {
+        std::cerr << "Cannot write " << output << std::endl;
+        return 1;
+    }
+    closeDataset(&dataset);
+    freeTranspositionTable();
+
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Resolved " << count << " positions in " << secs << "s: kept " << kept
+              << " (" << moved << " moved to a qsearch leaf, " << (double)leafPlies / std::max<size_t>(1, moved)
+              << " plies on average), dropped " << dropped[resolveInCheck] << " in check, "
+              << dropped[resolveMate] << " mate scores, " << dropped[resolveLeafInCheck] << " with a leaf in check" << std::endl;
+    return 0;
 }
 
 int main(int argc, char* argv[]) {
+    if (argc >= 4 && std::string(argv[1]) == "--convert") {
+        initializeMoveTables();
+        initializeRandomKeys();
+        return convertPositions(argv[2], argv[3]);
+    }
+
+    if (argc >= 4 && std::string(argv[1]) == "--resolve") {
+        initializeMoveTables();
+        initializeRandomKeys();
+        initializeEvaluationMasks();
+        NUM_THREADS = (argc >= 5) ? std::max(1, std::atoi(argv[4])) : NUM_THREADS;
+        initializeThreadPool(&tunerPool, NUM_THREADS);
+        int status = resolvePositions(argv[2], argv[3]);
+        destroyThreadPool(&tunerPool);
+        return status;
+    }
+
     if (argc < 2) {
-        std::cerr << "Usage: tuner <positions.txt> [threads] [regularization]" << std::endl;
-        std::cerr << "Format: FEN [result]  where result is 1.0, 0.5, or 0.0" << std::endl;
+        std::cerr << "Usage: tuner <positions.txt|positions.bin> [threads] [regularization] [adam|lbfgs|gn]" << std::endl;
+        std::cerr << "       tuner --convert <positions.txt> <positions.bin>" << std::endl;
+        std::cerr << "       tuner --resolve <positions.txt|positions.bin> <resolved.bin> [threads]" << std::endl;
+        std::cerr << "Format: FEN [result]  where result is 1.0, 0.5, or 0.0 (or FEN; 1-0)" << std::endl;
         std::cerr << "Regularization: 0.0 = no constraint, 0.001 = conservative" << std::endl;
         return 1;
     }
 
     if (argc >= 3) NUM_THREADS = std::atoi(argv[2]);
     if (argc >= 4) REGULARIZATION = std::atof(argv[3]);
+    std::string optimizer = (argc >= 5) ? argv[4] : "adam";
+    if (optimizer != "adam" && optimizer != "lbfgs" && optimizer != "gn") {
+        std::cerr << "Unknown optimizer " << optimizer << " (adam, lbfgs or gn)" << std::endl;
+        return 1;
+    }
+    NUM_THREADS = std::max(1, NUM_THREADS);
+    initializeThreadPool(&tunerPool, NUM_THREADS);
     std::cout << "Using " << NUM_THREADS << " threads" << std::endl;
     std::cout << "Regularization: " << REGULARIZATION << std::endl;
+    std::cout << "Optimizer: " << optimizer << std::endl;
 
     initializeMoveTables();
     initializeRandomKeys();
     initializeEvaluationMasks();
 
-    auto positions = loadPositions(argv[1]);
-    if (positions.empty()) {
+    PackedDataset dataset;
+    std::vector<PackedPosition> packed;
+    if (!loadPositions(argv[1], dataset, packed)) {
         std::cerr << "No positions loaded." << std::endl;
         return 1;
     }
 
-    findOptimalK(positions);
-
     std::vector<TuneParam> params;
     registerParams(params);
     globalParams = &params;
-    std::cout << "Tuning " << params.size() << " parameters over " << positions.size() << " positions" << std::endl;
 
-    adamOptimize(positions, params);
-    localSearch(positions, params);
+    TraceSet traces = buildTraces(dataset.positions, dataset.count, params);
+    closeDataset(&dataset);
+    std::vector<PackedPosition>().swap(packed);
+
+    findOptimalK(traces);
+    std::cout << "Tuning " << params.size() << " parameters over " << traces.positions.size() << " positions" << std::endl;
+
+    if (optimizer == "lbfgs") lbfgsOptimize(traces, params);
+    else if (optimizer == "gn") gaussNewtonOptimize(traces, params);
+    else adamOptimize(traces, params);
+    localSearch(traces, params);
     printResults(params);
 
+    destroyThreadPool(&tunerPool);
     return 0;
 }
@@ -0,0 +1,255 @@
+#include "../src/search.h"
+#include "dataset.h"
+#include "threadpool.h"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Self-play data generator. Every game starts from a few random plies off the start position
+// and is played out with fixed-depth searches (optionally capped by a soft node limit); the
+// quiet positions are kept with the search score, labelled with the final result once the game
+// is over and streamed to a packed dataset that the tuner loads directly.
+
+#define randomOpeningPlies 8
+#define openingScoreLimit 400  // openings searched worse than this for either side are replayed
+#define maxGamePlies 400
+#define winAdjudicateScore 1500
+#define winAdjudicatePlies 6
+#define drawAdjudicateScore 10
+#define drawAdjudicatePlies 12
+#define drawAdjudicateAfter 80
+
+struct DatagenConfig {
+    uint64_t targetPositions;
+    int depth;
+    uint64_t nodes; // soft limit checked between iterations, 0 for none
+    uint64_t seed;
+};
+
+struct GameRecord {
+    Board board;
+    GameHistory history;
+    int plies;
+};
+
+// Hashes already written, split into shards so workers rarely wait on each other
+struct DedupShard {
+    std::mutex lock;
+    std::unordered_set<U64> seen;
+};
+
+static DedupShard dedupShards[64];
+
+static inline bool insertUnique(U64 hash) {
+    DedupShard &shard = dedupShards[hash >> 58];
+    std::lock_guard<std::mutex> lock(shard.lock);
+    return shard.seen.insert(hash).second;
+}
+
+static inline U64 nextRandom(U64 *state) {
+    U64 z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static inline void playRecordedMove(GameRecord *game, int move) {
+    StateInfo undo;
+    pushGameHistory(&game->history, game->board.zobristHash);
+    makeMoveUnchecked(&game->board, move, &undo);
+    game->plies++;
+}
+
+// Iterative deepening from the game position; returns the score for the side to move and
+// leaves the best move in *bestMove
+static int searchGamePosition(SearchThread *thread, const GameRecord *game, const DatagenConfig *config, int *bestMove) {
+    resetSearchThread(thread, &game->board, &game->history);
+
+    int score = 0;
+    *bestMove = 0;
+    for (int depth = 1; depth <= config->depth; depth++) {
+        thread->followPrincipalVariation = 1;
+        score = negamax(thread, -INFINITY, INFINITY, depth);
+        if (thread->PrincipalVariationLength[0] > 0 && thread->PrincipalVariationTable[0][0])
+            *bestMove = thread->PrincipalVariationTable[0][0];
+        if (config->nodes && thread->nodes.load(std::memory_order_relaxed) >= config->nodes) break;
+    }
+    return score;
+}
+
+static bool playRandomOpening(SearchThread *thread, GameRecord *game, const Board *start,
+                              const DatagenConfig *config, U64 *rng) {
+    memcpy(&game->board, start, sizeof(Board));
+    game->history.count = 0;
+    game->plies = 0;
+
+    int plies = randomOpeningPlies + (int)(nextRandom(rng) & 1);
+    for (int i = 0; i < plies; i++) {
+        MoveList moves;
+        generateLegalMoves(&game->board, &moves);
+        if (moves.count == 0) return false;
+        playRecordedMove(game, moves.moves[nextRandom(rng) % moves.count]);
+    }
+
+    MoveList moves;
+    generateLegalMoves(&game->board, &moves);
+    if (moves.count == 0) return false;
+
+    DatagenConfig shallow = *config;
+    shallow.depth = std::min(config->depth, 6);
+    int bestMove;
+    return std::abs(searchGamePosition(thread, game, &shallow, &bestMove)) <= openingScoreLimit;
+}
+
+// Plays one game and appends its labelled quiet positions to positions; returns the number kept
+static size_t playDatagenGame(SearchThread *thread, const Board *start, const DatagenConfig *config,
+                              U64 gameSeed, std::vector<PackedPosition> &positions) {
+    std::unique_ptr<GameRecord> game(new GameRecord);
+    U64 rng = gameSeed;
+    while (!playRandomOpening(thread, game.get(), start, config, &rng)) {}
+
+    size_t first = positions.size();
+    std::vector<U64> hashes;
+    double result = 0.5;
+    int winPlies = 0, drawPlies = 0, lastWhiteScore = 0;
+
+    while (true) {
+        Board *board = &game->board;
+        int inCheck = isBoardInCheck(board);
+
+        MoveList moves;
+        generateLegalMoves(board, &moves);
+        if (moves.count == 0) {
+            result = inCheck ? (board->sideToMove == white ? 0.0 : 1.0) : 0.5;
+            break;
+        }
+        if (board->halfMoveClock >= 100 || isThreefoldRepetition(&game->board, &game->history) || insufficientMaterial(board)
+            || game->plies >= maxGamePlies)
+            break;
+
+        int bestMove;
+        int score = searchGamePosition(thread, game.get(), config, &bestMove);
+        if (!bestMove) bestMove = moves.moves[0];
+        int whiteScore = board->sideToMove == white ? score : -score;
+
+        // Win adjudication needs both sides to agree, which consecutive plies of one sign give
+        bool winning = std::abs(score) >= winAdjudicateScore && (winPlies == 0 || (whiteScore > 0) == (lastWhiteScore > 0));
+        winPlies = winning ? winPlies + 1 : 0;
+        lastWhiteScore = whiteScore;
+        if (winPlies >= winAdjudicatePlies) {
+            result = whiteScore > 0 ? 1.0 : 0.0;
+            break;
+        }
+        drawPlies = (game->plies >= drawAdjudicateAfter && std::abs(score) <= drawAdjudicateScore) ? drawPlies + 1 : 0;
+        if (drawPlies >= drawAdjudicatePlies) break;
+
+        // Only quiet positions are labelled: the static eval the tuner fits cannot see
+        // hanging pieces, so positions in check or whose best move wins material are skipped
+        if (!inCheck && !decodeCapture(bestMove) && !decodePromoted(bestMove) && std::abs(score) < MATESCORE) {
+            positions.push_back(packPosition(board, 0.5, whiteScore, 1 + game->plies / 2));
+            hashes.push_back(board->zobristHash);
+        }
+
+        playRecordedMove(game.get(), bestMove);
+    }
+
+    // Label the kept positions and drop repeats of anything already written
+    size_t kept = first;
+    for (size_t i = first; i < positions.size(); i++) {
+        if (!insertUnique(hashes[i - first])) continue;
+        positions[kept] = positions[i];
+        positions[kept].result = (uint8_t)(result * 2.0 + 0.5);
+        kept++;
+    }
+    positions.resize(kept);
+    return kept - first;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: datagen <output.bin> [positions] [threads] [depth] [nodes] [seed]" << std::endl;
+        std::cerr << "  positions: unique positions to write (default 1000000)" << std::endl;
+        std::cerr << "  depth:     search depth per move (default 8)" << std::endl;
+        std::cerr << "  nodes:     soft node limit per move, 0 for none (default 0)" << std::endl;
+        return 1;
+    }
+
+    DatagenConfig config;
+    config.targetPositions = (argc > 2) ? std::stoull(argv[2]) : 1000000;
+    int threads = (argc > 3) ? std::max(1, std::atoi(argv[3])) : std::max(1, (int)std::thread::hardware_concurrency());
+    config.depth = (argc > 4) ? std::max(1, std::min(maxPly - 1, std::atoi(argv[4]))) : 8;
+    config.nodes = (argc > 5) ? std::stoull(argv[5]) : 0;
+    config.seed = (argc > 6) ? std::stoull(argv[6]) : (U64)TIME_IN_MILLISECONDS;
+
+    initializeMoveTables();
+    initializeRandomKeys();
+    initializeEvaluationMasks();
+    initializeTranspositionSize(16 * threads);
+
+    Board start;
+    parseFEN(&start, start_position);
+
+    DatasetWriter writer;
+    if (!openDatasetWriter(&writer, argv[1])) {
+        std::cerr << "Cannot write " << argv[1] << std::endl;
+        return 1;
+    }
+
+    std::cout << "Datagen: " << config.targetPositions << " positions | depth " << config.depth;
+    if (config.nodes) std::cout << " | nodes " << config.nodes;
+    std::cout << " | " << threads << " threads | seed " << config.seed << std::endl;
+
+    // Every worker plays whole games until the target is reached; finished games are written
+    // under one lock so each game's positions stay together in the file
+    std::unique_ptr<SearchThread[]> searchers(new SearchThread[threads]);
+    for (int i = 0; i < threads; i++) {
+        searchers[i].id = i + 1; // id 0 would poll stdin for UCI commands
+        memset(&searchers[i].pawnTable, 0, sizeof(PawnHashTable));
+    }
+    std::atomic<uint64_t> written{0}, games{0};
+    std::mutex writerLock;
+    auto startTime = std::chrono::steady_clock::now();
+    double lastReport = 0;
+
+    ThreadPool pool;
+    initializeThreadPool(&pool, threads);
+    parallelFor(&pool, threads, 1, [&](int worker, size_t, size_t) {
+        std::vector<PackedPosition> positions;
+        while (written.load() < config.targetPositions) {
+            uint64_t game = games++;
+            positions.clear();
+            playDatagenGame(&searchers[worker], &start, &config, config.seed + game * 0x9E3779B97F4A7C15ULL, positions);
+
+            std::lock_guard<std::mutex> lock(writerLock);
+            uint64_t room = config.targetPositions - std::min(config.targetPositions, written.load());
+            size_t count = std::min<uint64_t>(room, positions.size());
+            writePositions(&writer, positions.data(), count);
+            written += count;
+
+            double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+            if (secs - lastReport >= 10 || written.load() >= config.targetPositions) {
+                lastReport = secs;
+                std::cout << "  " << written.load() << " positions, " << games.load() << " games, "
+                          << (uint64_t)(written.load() / std::max(secs, 1e-9) / threads) << " positions/s per thread" << std::endl;
+            }
+        }
+    });
+    destroyThreadPool(&pool);
+
+    if (!closeDatasetWriter(&writer)) {
+        std::cerr << "Cannot write " << argv[1] << std::endl;
+        return 1;
+    }
+    freeTranspositionTable();
+
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    std::cout << "Wrote " << writer.count << " positions from " << games.load() << " games in " << secs << "s ("
+              << (uint64_t)(writer.count / secs / threads) << " positions/s per thread)" << std::endl;
+    return 0;
+}
@@ -0,0 +1,263 @@
+#ifndef DATASET_H
+#define DATASET_H
+
+#include "../src/constants.h"
+#include "../src/board.h"
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <cstdio>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Packed board plus game result, 32 bytes per position. Pieces are stored one nibble per
+// occupied square in ascending square order, so the occupancy alone fixes where they go.
+struct PackedPosition {
+    U64 occupancy;
+    uint8_t pieces[16];       // up to 32 pieces, low nibble first
+    uint8_t flags;            // bit 0: black to move, bits 1-4: castling rights
+    uint8_t enPassantSquare;  // noSquare if none
+    uint8_t halfMoveClock;
+    uint8_t result;           // in half points for white: 0, 1 or 2
+    int16_t score;            // search score from white's point of view, 0 if unknown
+    uint16_t fullMoveNumber;
+};
+
+static_assert(sizeof(PackedPosition) == 32, "PackedPosition must stay 32 bytes");
+
+// File layout: this header followed by count PackedPositions
+struct DatasetHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t count;
+};
+
+static const char datasetMagic[4] = {'P', 'L', 'D', 'S'};
+#define datasetVersion 1
+
+static inline PackedPosition packPosition(const Board *board, double result, int score = 0, int fullMoveNumber = 1) {
+    PackedPosition packed;
+    memset(&packed, 0, sizeof(packed));
+    packed.occupancy = board->occupancies[both];
+
+    int index = 0;
+    U64 bitboard = packed.occupancy;
+    while (bitboard && index < 32) {
+        int square = getLSBindex(bitboard);
+        packed.pieces[index / 2] |= board->pieceOn[square] << (4 * (index & 1));
+        index++;
+        popBit(bitboard, square);
+    }
+
+    packed.flags = (board->sideToMove == black) | (board->castlingRights << 1);
+    packed.enPassantSquare = board->enPassantSquare;
+    packed.halfMoveClock = std::min(board->halfMoveClock, 255);
+    packed.result = (uint8_t)(result * 2.0 + 0.5);
+    packed.score = (int16_t)std::max(-32767, std::min(32767, score));
+    packed.fullMoveNumber = (uint16_t)fullMoveNumber;
+    return packed;
+}
+
+static inline void unpackPosition(const PackedPosition *packed, Board *board) {
+    clearBoard(board);
+
+    int index = 0;
+    U64 bitboard = packed->occupancy;
+    while (bitboard) {
+        int square = getLSBindex(bitboard);
+        int piece = (packed->pieces[index / 2] >> (4 * (index & 1))) & 15;
+        setBit(board->bitboards[piece], square);
+        board->pieceOn[square] = (uint8_t)piece;
+        index++;
+        popBit(bitboard, square);
+    }
+
+    for (int piece = P; piece <= K; ++piece) board->occupancies[white] |= board->bitboards[piece];
+    for (int piece = p; piece <= k; ++piece) board->occupancies[black] |= board->bitboards[piece];
+    board->occupancies[both] = packed->occupancy;
+    board->occupancies[3] = ~packed->occupancy;
+
+    board->sideToMove = (packed->flags & 1) ? black : white;
+    board->castlingRights = (packed->flags >> 1) & 15;
+    board->enPassantSquare = packed->enPassantSquare;
+    board->halfMoveClock = packed->halfMoveClock;
+
+    board->zobristHash = computeZobristHash(board);
+    board->pawnHash = computePawnHash(board);
+    refreshPieceScores(board);
+}
+
+static inline double positionResult(const PackedPosition *packed) {
+    return packed->result / 2.0;
+}
+
+// Splits a "FEN [1.0]" or "FEN; 1-0" line; false if the line has neither form
+static inline bool parseResultLine(const std::string& line, std::string& fen, double& result) {
+    size_t bracketOpen = line.find('[');
+    size_t bracketClose = line.find(']');
+    size_t semicolon = line.find(';');
+    std::string resultStr;
+
+    if (bracketOpen != std::string::npos && bracketClose != std::string::npos) {
+        fen = line.substr(0, bracketOpen);
+        resultStr = line.substr(bracketOpen + 1, bracketClose - bracketOpen - 1);
+    } else if (semicolon != std::string::npos) {
+        fen = line.substr(0, semicolon);
+        resultStr = line.substr(semicolon + 1);
+    } else {
+        return false;
+    }
+
+    while (!fen.empty() && fen.back() == ' ') fen.pop_back();
+    while (!resultStr.empty() && resultStr.front() == ' ') resultStr.erase(resultStr.begin());
+    while (!resultStr.empty() && (resultStr.back() == ' ' || resultStr.back() == '\r')) resultStr.pop_back();
+
+    if (resultStr == "1.0" || resultStr == "1-0") result = 1.0;
+    else if (resultStr == "0.0" || resultStr == "0-1") result = 0.0;
+    else result = 0.5;
+    return true;
+}
+
+// The sixth FEN field, which Board does not keep
+static inline int fenFullMoveNumber(const std::string& fen) {
+    std::istringstream iss(fen);
+    std::string field;
+    int fullMove = 1;
+    for (int i = 0; i < 6 && iss >> field; ++i) {
+        if (i == 5) fullMove = std::max(1, std::atoi(field.c_str()));
+    }
+    return fullMove;
+}
+
+// Reads a text dataset and packs every line through parseFEN
+static inline std::vector<PackedPosition> readTextDataset(const std::string& filename) {
+    std::vector<PackedPosition> positions;
+    std::ifstream file(filename);
+    if (!file.is_open()) return positions;
+
+    std::string line, fen;
+    double result;
+    Board board;
+    while (std::getline(file, line)) {
+        if (line.empty() || !parseResultLine(line, fen, result)) continue;
+        parseFEN(&board, fen);
+        positions.push_back(packPosition(&board, result, 0, fenFullMoveNumber(fen)));
+    }
+    return positions;
+}
+
+// Streaming writer, the count in the header is filled in on close
+struct DatasetWriter {
+    FILE *file;
+    uint64_t count;
+};
+
+static inline bool openDatasetWriter(DatasetWriter *writer, const std::string& filename) {
+    writer->count = 0;
+    writer->file = fopen(filename.c_str(), "wb");
+    if (!writer->file) return false;
+    DatasetHeader header = {{datasetMagic[0], datasetMagic[1], datasetMagic[2], datasetMagic[3]}, datasetVersion, 0};
+    return fwrite(&header, sizeof(header), 1, writer->file) == 1;
+}
+
+static inline void writePositions(DatasetWriter *writer, const PackedPosition *positions, size_t count) {
+    writer->count += fwrite(positions, sizeof(PackedPosition), count, writer->file);
+}
+
+static inline bool closeDatasetWriter(DatasetWriter *writer) {
+    if (!writer->file) return false;
+    DatasetHeader header = {{datasetMagic[0], datasetMagic[1], datasetMagic[2], datasetMagic[3]}, datasetVersion, writer->count};
+    bool ok = fseek(writer->file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, writer->file) == 1;
+    ok = (fclose(writer->file) == 0) && ok;
+    writer->file = NULL;
+    return ok;
+}
+
+static inline bool writeDataset(const std::string& filename, const std::vector<PackedPosition>& positions) {
+    DatasetWriter writer;
+    if (!openDatasetWriter(&writer, filename)) return false;
+    writePositions(&writer, positions.data(), positions.size());
+    return closeDatasetWriter(&writer) && writer.count == positions.size();
+}
+
+// Read-only view of a dataset file. On POSIX systems the file is mapped, so positions are
+// paged in on demand and shared with the page cache instead of being copied to the heap
+struct PackedDataset {
+    const PackedPosition *positions;
+    size_t count;
+    void *mapping;
+    size_t mappedBytes;
+};
+
+static inline bool isDatasetFile(const std::string& filename) {
+    FILE *file = fopen(filename.c_str(), "rb");
+    if (!file) return false;
+    char magic[4] = {0};
+    bool binary = fread(magic, 1, 4, file) == 4 && memcmp(magic, datasetMagic, 4) == 0;
+    fclose(file);
+    return binary;
+}
+
+static inline void closeDataset(PackedDataset *dataset) {
+    if (!dataset->mapping) return;
+#ifdef _WIN32
+    free(dataset->mapping);
+#else
+    munmap(dataset->mapping, dataset->mappedBytes);
+#endif
+    dataset->positions = NULL;
+    dataset->count = 0;
+    dataset->mapping = NULL;
+    dataset->mappedBytes = 0;
+}
+
+static inline bool openDataset(PackedDataset *dataset, const std::string& filename) {
+    dataset->positions = NULL;
+    dataset->count = 0;
+    dataset->mapping = NULL;
+    dataset->mappedBytes = 0;
+
+#ifdef _WIN32
+    FILE *file = fopen(filename.c_str(), "rb");
+    if (!file) return false;
+    fseek(file, 0, SEEK_END);
+    size_t bytes = (size_t)ftell(file);
+    fseek(file, 0, SEEK_SET);
+    void *mapping = malloc(bytes ? bytes : 1);
+    bool ok = mapping && fread(mapping, 1, bytes, file) == bytes;
+    fclose(file);
+    if (!ok) { free(mapping); return false; }
+#else
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(DatasetHeader)) { close(fd); return false; }
+    size_t bytes = (size_t)st.st_size;
+    void *mapping = mmap(NULL, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) return false;
+    madvise(mapping, bytes, MADV_SEQUENTIAL);
+#endif
+
+    dataset->mapping = mapping;
+    dataset->mappedBytes = bytes;
+
+    const DatasetHeader *header = (const DatasetHeader *)mapping;
+    if (bytes < sizeof(DatasetHeader) || memcmp(header->magic, datasetMagic, 4) != 0
+        || header->version != datasetVersion
+        || header->count > (bytes - sizeof(DatasetHeader)) / sizeof(PackedPosition)) {
+        closeDataset(dataset);
+        return false;
+    }
+
+    dataset->positions = (const PackedPosition *)((const char *)mapping + sizeof(DatasetHeader));
+    dataset->count = header->count;
+    return true;
+}
+
+#endif // DATASET_H
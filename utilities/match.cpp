@@ -3,105 +3,150 @@
 #include "../src/precalculated_move_tables.h"
 #include "../src/moves.h"
 #include "../src/evaluate.h"
+#include "dataset.h"
 
-#include <atomic>
+#include <climits>
+#include <cmath>
 #include <cstdio>
+#include <ctime>
+#include <fcntl.h>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
-#include <mutex>
+#include <random>
+#include <sched.h>
+#include <set>
+#include <signal.h>
 #include <sstream>
 #include <string>
+#include <sys/epoll.h>
 #include <sys/wait.h>
-#include <thread>
 #include <unistd.h>
 #include <vector>
 
+// All engines are driven from one thread. Every engine's stdout is a non-blocking pipe
+// registered with epoll; output is split into lines as it arrives and each line advances the
+// state of the game that owns the engine. An engine is waiting for at most one reply at a
+// time, and that reply has its own deadline, which bounds the epoll_wait timeout, so a clock
+// runs out exactly when it should even if the engine prints nothing.
+
+static inline long long steadyMilliseconds() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+enum EngineWait { waitNone, waitUciOk, waitReadyOk, waitBestmove, waitBench };
+
+#define infoMateScore 100000
+
+// The last "info" line with a score for the engine's current search
+struct SearchInfo {
+    bool hasScore = false;
+    int score = 0;            // centipawns for the side to move; mate in n is infoMateScore - n
+    int depth = 0;
+    long long nodes = 0;
+    long long timeMs = 0;
+    long long nps = 0;
+};
+
 struct UCIEngine {
-    FILE *childIn = nullptr;
-    FILE *childOut = nullptr;
     pid_t pid = -1;
+    int inFd = -1;            // engine stdin
+    int outFd = -1;           // engine stdout, non-blocking
+    std::string partialLine;
+    EngineWait waiting = waitNone;
+    long long deadline = 0;   // steady clock
+    std::string goCommand;    // sent as soon as the readyok before it arrives
+    int goTimeoutMs = 0;
+    long long goSentAt = 0;
+    bool draining = false;    // the next bestmove belongs to an abandoned search
+    SearchInfo info;
+    bool failed = false;
+    long long benchNps = 0;   // from the calibration bench, 0 until it has run
+    int slot = 0;
+    int role = 0;             // 0 main, 1 search
+};
 
-    bool launch(const char *path) {
-        int toChild[2], fromChild[2];
-        if (pipe(toChild) || pipe(fromChild)) return false;
-        pid = fork();
-        if (pid == 0) {
-            dup2(toChild[0], STDIN_FILENO);
-            dup2(fromChild[1], STDOUT_FILENO);
-            close(toChild[0]); close(toChild[1]);
-            close(fromChild[0]); close(fromChild[1]);
-            execl(path, path, nullptr);
-            _exit(127);
-        }
-        close(toChild[0]);
-        close(fromChild[1]);
-        childIn = fdopen(toChild[1], "w");
-        childOut = fdopen(fromChild[0], "r");
-        setvbuf(childIn, nullptr, _IONBF, 0);
-        return childIn && childOut;
-    }
-
-    void cmd(const std::string &s) { fputs((s + "\n").c_str(), childIn); }
-
-    std::string drainUntil(const std::string &token, int timeoutMs) {
-        std::string lastLine;
-        long long deadline = TIME_IN_MILLISECONDS + timeoutMs;
-        char buf[4096];
-        while (TIME_IN_MILLISECONDS < deadline) {
-            if (!fgets(buf, sizeof(buf), childOut)) break;
-            std::string line(buf);
-            while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) line.pop_back();
-            if (line.rfind("info", 0) == 0) continue;
-            lastLine = line;
-            if (line.rfind(token, 0) == 0) return line;
+// One logical CPU per physical core this process may run on, from the sysfs topology; a CPU
+// whose topology cannot be read counts as a core of its own
+static std::vector<int> physicalCores() {
+    std::vector<int> cores;
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return cores;
+
+    std::set<std::pair<int, int>> seen; // (package, core)
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (!CPU_ISSET(cpu, &allowed)) continue;
+        std::string topology = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+        std::ifstream coreFile(topology + "core_id"), packageFile(topology + "physical_package_id");
+        int core = -1, package = -1;
+        if (!(coreFile >> core) || !(packageFile >> package)) {
+            core = cpu;
+            package = -1;
         }
-        return lastLine;
+        if (seen.insert({package, core}).second) cores.push_back(cpu);
     }
+    return cores;
+}
 
-    std::string bestmove(int movetimeMs) {
-        cmd("isready");
-        drainUntil("readyok", 5000);
-        cmd("go movetime " + std::to_string(movetimeMs));
-        return drainUntil("bestmove", movetimeMs + 10000);
+// cpu >= 0 pins the engine to that logical CPU before it starts
+static bool launchEngine(UCIEngine &engine, const char *path, int cpu) {
+    int toChild[2], fromChild[2];
+    // Close-on-exec keeps every other engine's pipe ends out of each child, so a dead engine
+    // shows up as end-of-file instead of being held open by its siblings
+    if (pipe2(toChild, O_CLOEXEC)) return false;
+    if (pipe2(fromChild, O_CLOEXEC)) {
+        close(toChild[0]); close(toChild[1]);
+        return false;
     }
-
-    void newGame() {
-        cmd("ucinewgame");
-        cmd("isready");
-        drainUntil("readyok", 5000);
+    engine.pid = fork();
+    if (engine.pid == 0) {
+        dup2(toChild[0], STDIN_FILENO);
+        dup2(fromChild[1], STDOUT_FILENO);
+        if (cpu >= 0) {
+            cpu_set_t mask;
+            CPU_ZERO(&mask);
+            CPU_SET(cpu, &mask);
+            sched_setaffinity(0, sizeof(mask), &mask);
+        }
+        execl(path, path, nullptr);
+        _exit(127);
     }
+    close(toChild[0]);
+    close(fromChild[1]);
+    engine.inFd = toChild[1];
+    engine.outFd = fromChild[0];
+    fcntl(engine.outFd, F_SETFL, fcntl(engine.outFd, F_GETFL) | O_NONBLOCK);
+    return engine.pid > 0;
+}
 
-    void shutdown() {
-        if (childIn) { cmd("quit"); fclose(childIn); childIn = nullptr; }
-        if (childOut) { fclose(childOut); childOut = nullptr; }
-        if (pid > 0) { waitpid(pid, nullptr, 0); pid = -1; }
+static void sendLine(UCIEngine &engine, const std::string &s) {
+    if (engine.failed) return;
+    std::string line = s + "\n";
+    size_t written = 0;
+    while (written < line.size()) {
+        ssize_t n = write(engine.inFd, line.data() + written, line.size() - written);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return; // a dead engine is noticed when its stdout closes
+        written += (size_t)n;
     }
-};
-
-static std::mutex boardMutex;
+}
 
-static int countPositionOccurrences(U64 hash, const std::vector<U64> &history) {
-    int count = 0;
-    for (U64 h : history)
-        if (h == hash) count++;
-    return count;
+static void expectReply(UCIEngine &engine, EngineWait wait, int timeoutMs) {
+    engine.waiting = wait;
+    engine.deadline = steadyMilliseconds() + timeoutMs;
 }
 
 static int countLegalMoves(Board *board) {
     MoveList moveList;
-    generateMoves(board, &moveList);
-    copyBoard(board);
-    int legalMoves = 0;
-    for (int i = 0; i < moveList.count; ++i) {
-        if (makeMove(board, moveList.moves[i]) == 0) { takeBack(board, backup); continue; }
-        legalMoves++;
-        takeBack(board, backup);
-    }
-    return legalMoves;
+    generateLegalMoves(board, &moveList);
+    return moveList.count;
 }
 
 static int parseMoveStr(Board *board, const std::string &moveStr) {
     MoveList moveList[1];
-    generateMoves(board, moveList);
+    generateLegalMoves(board, moveList);
     if (moveStr.length() < 4) return 0;
 
     int source = (moveStr[0] - 'a') + (moveStr[1] - '1') * 8;
@@ -126,6 +171,49 @@ static int parseMoveStr(Board *board, const std::string &moveStr) {
     return 0;
 }
 
+// Standard algebraic notation for a legal move, played on the board to find the check suffix
+static std::string moveToSAN(Board *board, int move) {
+    int source = decodeSource(move), target = decodeTarget(move);
+    int piece = decodePiece(move) % 6; // P..K for either colour
+    std::string san;
+
+    if (decodeCastling(move)) {
+        san = (target % 8 == 6) ? "O-O" : "O-O-O";
+    } else {
+        if (piece != P) {
+            san += asciiPieces[piece];
+            // Disambiguate by file, then rank, then both, against same pieces reaching the target
+            MoveList moveList;
+            generateLegalMoves(board, &moveList);
+            bool ambiguous = false, sameFile = false, sameRank = false;
+            for (int i = 0; i < moveList.count; ++i) {
+                int other = moveList.moves[i];
+                if (decodePiece(other) != decodePiece(move) || decodeTarget(other) != target || decodeSource(other) == source) continue;
+                ambiguous = true;
+                sameFile |= decodeSource(other) % 8 == source % 8;
+                sameRank |= decodeSource(other) / 8 == source / 8;
+            }
+            if (ambiguous && (!sameFile || sameRank)) san += (char)('a' + source % 8);
+            if (ambiguous && sameFile) san += (char)('1' + source / 8);
+        } else if (decodeCapture(move)) {
+            san += (char)('a' + source % 8);
+        }
+        if (decodeCapture(move)) san += 'x';
+        san += indexToSquare[target];
+        if (decodePromoted(move)) {
+            san += '=';
+            san += asciiPieces[decodePromoted(move) % 6];
+        }
+    }
+
+    Board after = *board;
+    StateInfo undo;
+    makeMoveUnchecked(&after, move, &undo);
+    Board *pos = &after;
+    if (isBoardInCheck(pos)) san += countLegalMoves(pos) ? "+" : "#";
+    return san;
+}
+
 static std::string extractBestmove(const std::string &line) {
     std::istringstream ss(line);
     std::string tag, move;
@@ -133,167 +221,991 @@ static std::string extractBestmove(const std::string &line) {
     return move;
 }
 
+// Reads the search fields of an "info" line into *info; false if the line carries no score,
+// which leaves *info as it was. Mates become a score beyond any centipawn value.
+static bool parseInfoLine(const std::string &line, SearchInfo *info) {
+    std::istringstream ss(line);
+    std::string token;
+    SearchInfo parsed;
+    while (ss >> token) {
+        if (token == "string") return false;
+        if (token == "depth") ss >> parsed.depth;
+        else if (token == "nodes") ss >> parsed.nodes;
+        else if (token == "time") ss >> parsed.timeMs;
+        else if (token == "nps") ss >> parsed.nps;
+        else if (token == "pv") break;
+        else if (token == "score") {
+            std::string kind;
+            int value;
+            if (!(ss >> kind >> value)) return false;
+            if (kind == "cp") parsed.score = value;
+            else if (kind == "mate") parsed.score = value > 0 ? infoMateScore - value : -infoMateScore - value;
+            else return false;
+            parsed.hasScore = true;
+        }
+    }
+    if (!parsed.hasScore) return false;
+    if (!parsed.nps && parsed.timeMs > 0) parsed.nps = parsed.nodes * 1000 / parsed.timeMs;
+    *info = parsed;
+    return true;
+}
+
+// Opening suite read from an EPD or FEN file. Only the byte offset of each line is kept, and a
+// line is read from disk when its pair starts, so large suites cost 8 bytes per opening.
+// Sequential order walks the file and wraps around; random order walks a seeded shuffle.
+struct OpeningBook {
+    std::ifstream file;
+    std::vector<std::streamoff> offsets;
+    std::vector<uint32_t> order;
+};
+
+static bool openOpeningBook(OpeningBook &book, const std::string &path, bool randomOrder, uint64_t seed) {
+    book.file.open(path, std::ios::binary);
+    if (!book.file.is_open()) return false;
+
+    std::string line;
+    std::streamoff offset = 0;
+    while (std::getline(book.file, line)) {
+        if (line.find_first_not_of(" \t\r") != std::string::npos && line[0] != '#')
+            book.offsets.push_back(offset);
+        offset = book.file.tellg();
+    }
+    book.file.clear();
+
+    book.order.resize(book.offsets.size());
+    for (size_t i = 0; i < book.order.size(); ++i) book.order[i] = (uint32_t)i;
+    if (randomOrder) {
+        std::mt19937_64 rng(seed);
+        std::shuffle(book.order.begin(), book.order.end(), rng);
+    }
+    return !book.offsets.empty();
+}
+
+// EPD lines carry four FEN fields followed by opcodes; the move counters default to "0 1"
+static std::string openingLineToFen(const std::string &line) {
+    std::istringstream ss(line.substr(0, line.find(';')));
+    std::vector<std::string> fields;
+    std::string field;
+    while (fields.size() < 6 && ss >> field) fields.push_back(field);
+    if (fields.size() < 4) return "";
+
+    std::string fen = fields[0] + " " + fields[1] + " " + fields[2] + " " + fields[3];
+    bool counters = fields.size() == 6 && isdigit((unsigned char)fields[4][0]) && isdigit((unsigned char)fields[5][0]);
+    return fen + (counters ? " " + fields[4] + " " + fields[5] : " 0 1");
+}
+
+// The opening for a pair: its index in the file and its FEN
+static std::string nextOpening(OpeningBook &book, size_t pair, int &index) {
+    index = (int)book.order[pair % book.order.size()];
+    book.file.clear();
+    book.file.seekg(book.offsets[index]);
+    std::string line;
+    std::getline(book.file, line);
+    return openingLineToFen(line);
+}
+
 enum GameResult { WHITE_WIN, BLACK_WIN, DRAW, ABORT };
 
-static GameResult playGame(UCIEngine &whiteEngine, UCIEngine &blackEngine, int movetimeMs,
-                           std::vector<std::string> &moveHistory, std::string &resultNote) {
-    Board gameBoard;
-    std::vector<U64> positionHistory;
-    {
-        std::lock_guard<std::mutex> lock(boardMutex);
-        parseFEN(&gameBoard, start_position);
-        positionHistory.push_back(gameBoard.zobristHash);
-    }
-    moveHistory.clear();
-    resultNote.clear();
-
-    whiteEngine.newGame();
-    blackEngine.newGame();
-
-    for (;;) {
-        GameResult terminal;
-        bool gameOver = false;
-        int sideToMove;
-        {
-            std::lock_guard<std::mutex> lock(boardMutex);
-            Board *pos = &gameBoard;
-            if (countLegalMoves(pos) == 0) {
-                if (isBoardInCheck(pos)) {
-                    terminal = (gameBoard.sideToMove == white ? BLACK_WIN : WHITE_WIN);
-                    resultNote = "checkmate";
-                } else {
-                    terminal = DRAW;
-                    resultNote = "stalemate";
-                }
-                gameOver = true;
+// Without a base time every move is a fixed "go movetime". With one, each side has a clock:
+// the engines get full wtime/btime/winc/binc commands, and the wall time a move takes is
+// measured here and deducted. A side that overruns its clock by more than the margin loses.
+struct TimeControl {
+    int movetimeMs = 500;
+    int baseMs = 0;
+    int incrementMs = 0;
+    int marginMs = 50;
+};
+
+// Ends games whose outcome both engines already agree on, using the scores they report.
+// Resign: every score for resignMoves moves of each side puts the same side at least
+// resignScore ahead. Draw: every score for drawMoves moves of each side is within drawScore,
+// once drawAfter moves of the game have been played. Zero moves turns a rule off.
+struct AdjudicationConfig {
+    int resignScore = 1000;
+    int resignMoves = 0;
+    int drawScore = 10;
+    int drawMoves = 0;
+    int drawAfter = 40;
+};
+
+enum Adjudication { adjudicatedNone, adjudicatedResign, adjudicatedDraw, adjudicatedMaterial };
+
+// Only positions no sequence of moves can mate in: bare kings, a lone minor piece, or one
+// bishop each on the same colour. The engine's own test also counts other minor piece pairs.
+static bool isDeadMaterial(Board *board) {
+    if (!insufficientMaterial(board)) return false;
+    bool whiteBare = (board->occupancies[white] & ~board->bitboards[K]) == 0;
+    bool blackBare = (board->occupancies[black] & ~board->bitboards[k]) == 0;
+    return whiteBare || blackBare || (board->bitboards[B] && board->bitboards[b]);
+}
+
+// Clock state and time usage for one game, indexed by colour
+struct GameClock {
+    long long remainingMs[2] = {0, 0};
+    long long usedMs[2] = {0, 0};
+    int moves[2] = {0, 0};
+    int flagged = -1; // colour that lost on time
+};
+
+static std::string goParams(const TimeControl &tc, const GameClock &clock) {
+    if (tc.baseMs <= 0) return "movetime " + std::to_string(tc.movetimeMs);
+    return "wtime " + std::to_string(std::max(1LL, clock.remainingMs[white])) +
+           " btime " + std::to_string(std::max(1LL, clock.remainingMs[black])) +
+           " winc " + std::to_string(tc.incrementMs) + " binc " + std::to_string(tc.incrementMs);
+}
+
+// Search telemetry of one engine over the match, from the last info line of each move
+struct EngineTelemetry {
+    long long nodes = 0;
+    long long searchMs = 0;   // the engine's own reported time
+    long long depthSum = 0;
+    int reportedMoves = 0;
+    std::vector<int> moveMs;  // wall time of every move
+};
+
+struct MatchTotals {
+    int mainWins = 0;
+    int searchWins = 0;
+    int draws = 0;
+    int aborted = 0;
+    int mainMoves = 0, searchMoves = 0;
+    long long mainTimeMs = 0, searchTimeMs = 0;
+    int mainFlags = 0, searchFlags = 0;
+    int adjudicated[4] = {0, 0, 0, 0}; // by Adjudication
+    std::vector<int> adjudicatedPlies; // game length at each adjudication
+    EngineTelemetry telemetry[2];      // main, search
+    std::vector<int> naturalPlies;     // length of each game that ended on the board
+    long long totalPlies = 0;
+};
+
+// Game pairs are the same opening with colours swapped, so their two results are not
+// independent. Counting pair scores (0, 0.5, 1, 1.5 or 2 points for main) instead of single
+// games keeps that correlation in the variance, which is what makes the error bars honest.
+struct Pentanomial {
+    int counts[5] = {0, 0, 0, 0, 0}; // indexed by main's pair score in half points
+};
+
+struct SprtConfig {
+    bool enabled = false;
+    double elo0 = 0, elo1 = 5;
+    double alpha = 0.05, beta = 0.05;
+};
+
+struct MatchStats {
+    int pairs = 0;
+    double score = 0.5;   // mean game score for main
+    double elo = 0;
+    double eloError = 0;  // 95% half-width
+    double los = 0.5;
+    double llr = 0;
+};
+
+static double scoreToElo(double score) {
+    score = std::min(std::max(score, 1e-6), 1.0 - 1e-6);
+    return -400.0 * std::log10(1.0 / score - 1.0);
+}
+
+static double eloToScore(double elo) {
+    return 1.0 / (1.0 + std::pow(10.0, -elo / 400.0));
+}
+
+static double sprtLowerBound(const SprtConfig &sprt) { return std::log(sprt.beta / (1.0 - sprt.alpha)); }
+static double sprtUpperBound(const SprtConfig &sprt) { return std::log((1.0 - sprt.beta) / sprt.alpha); }
+
+// Logistic Elo from the pair scores. The LLR is the normal approximation to the generalized
+// SPRT: N (s1 - s0) (2 mean - s0 - s1) / (2 variance) with per-pair mean and variance. The
+// variance gets half a pair of prior in every bin, so a lopsided start cannot look certain;
+// its weight fades as pairs come in.
+static MatchStats pentanomialStats(const Pentanomial &penta, const SprtConfig &sprt) {
+    MatchStats stats;
+    for (int i = 0; i < 5; i++) stats.pairs += penta.counts[i];
+    if (stats.pairs == 0) return stats;
+
+    double mean = 0;
+    for (int i = 0; i < 5; i++) mean += penta.counts[i] * (i / 4.0);
+    mean /= stats.pairs;
+
+    double prior = 0.5, variance = 0;
+    for (int i = 0; i < 5; i++)
+        variance += (penta.counts[i] + prior) * (i / 4.0 - mean) * (i / 4.0 - mean);
+    variance /= stats.pairs + 5 * prior;
+
+    double stdError = std::sqrt(variance / stats.pairs);
+    stats.score = mean;
+    stats.elo = scoreToElo(mean);
+    stats.eloError = (scoreToElo(mean + 1.96 * stdError) - scoreToElo(mean - 1.96 * stdError)) / 2.0;
+    stats.los = 0.5 * std::erfc(-(mean - 0.5) / (stdError * std::sqrt(2.0)));
+
+    double s0 = eloToScore(sprt.elo0), s1 = eloToScore(sprt.elo1);
+    stats.llr = stats.pairs * (s1 - s0) * (2.0 * mean - s0 - s1) / (2.0 * variance);
+    return stats;
+}
+
+static std::string formatStats(const Pentanomial &penta, const MatchStats &stats, const SprtConfig &sprt) {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(1)
+        << "Pairs " << stats.pairs << " | Elo " << stats.elo << " +/- " << stats.eloError
+        << " | LOS " << stats.los * 100.0 << "%";
+    if (sprt.enabled)
+        oss << std::setprecision(2) << " | LLR " << stats.llr
+            << " (" << sprtLowerBound(sprt) << ", " << sprtUpperBound(sprt) << ")";
+    oss << " | Penta [" << penta.counts[0] << " " << penta.counts[1] << " " << penta.counts[2]
+        << " " << penta.counts[3] << " " << penta.counts[4] << "]";
+    return oss.str();
+}
+
+// A slot is one concurrent game: an engine pair that plays pair after pair. Its phase says
+// what it is waiting for; it moves on once both engines have answered. With calibration every
+// slot benches its engines first, and no game starts until all slots have.
+enum SlotPhase { phaseLaunching, phaseCalibrating, phaseCalibrated, phaseNewGame, phasePlaying, phaseFinishing, phaseIdle };
+
+struct GameSlot {
+    UCIEngine engines[2]; // main, search
+    SlotPhase phase = phaseLaunching;
+
+    int pair = -1;
+    int game = -1;        // even games have main as white
+    int opening = -1;     // line index in the opening file, -1 for the start position
+    std::string startFen;
+    int halfPoints = 0;   // main's score so far in this pair
+    bool pairComplete = true;
+
+    Board board;
+    GameHistory history;
+    std::vector<std::string> moves;
+    std::vector<std::string> pgnMoves; // SAN with its telemetry comment
+    std::string resultNote;
+    GameClock clock;
+    GameResult result = ABORT;
+    Adjudication adjudication = adjudicatedNone;
+    int resignPlies = 0;  // consecutive moves scored as a win for the same side
+    int drawPlies = 0;    // consecutive moves scored as level
+    int lastWhiteScore = 0;
+};
+
+struct MatchContext {
+    const char *enginePaths[2];
+    TimeControl tc;
+    SprtConfig sprt;
+    AdjudicationConfig adjudication;
+    OpeningBook *book = nullptr;
+    int hashMB = 0;       // 0 keeps the engines' default
+    std::ofstream *pgn = nullptr;
+    long long referenceNps = 0; // --calibrate; 0 plays the time control as given
+    std::vector<int> pinCpus;   // logical CPU per slot, empty when engines are not pinned
+    int pairs = 0;
+    int nextPair = 0;
+    bool stopRequested = false;
+    std::string sprtVerdict;
+    MatchTotals totals;
+    Pentanomial penta;
+    std::vector<GameSlot> slots;
+    int epollFd = -1;
+};
+
+static void advanceSlot(MatchContext &ctx, GameSlot &slot);
+static void finishGame(MatchContext &ctx, GameSlot &slot, GameResult result);
+
+static inline UCIEngine &whiteEngineOf(GameSlot &slot) { return slot.engines[slot.game % 2 == 0 ? 0 : 1]; }
+static inline UCIEngine &blackEngineOf(GameSlot &slot) { return slot.engines[slot.game % 2 == 0 ? 1 : 0]; }
+
+static void startGame(MatchContext &ctx, GameSlot &slot, int game) {
+    slot.game = game;
+    parseFEN(&slot.board, slot.startFen);
+    slot.history.count = 0;
+    slot.moves.clear();
+    slot.pgnMoves.clear();
+    slot.resultNote.clear();
+    slot.clock = GameClock();
+    slot.adjudication = adjudicatedNone;
+    slot.resignPlies = slot.drawPlies = 0;
+    slot.clock.remainingMs[white] = slot.clock.remainingMs[black] = ctx.tc.baseMs;
+    slot.phase = phaseNewGame;
+
+    for (UCIEngine &engine : slot.engines) {
+        sendLine(engine, "ucinewgame");
+        sendLine(engine, "isready");
+        expectReply(engine, waitReadyOk, 5000);
+    }
+}
+
+static void startNextPair(MatchContext &ctx, GameSlot &slot) {
+    if (ctx.stopRequested || ctx.nextPair >= ctx.pairs || slot.engines[0].failed || slot.engines[1].failed) {
+        slot.phase = phaseIdle;
+        return;
+    }
+
+    // Both games of a pair start from the same opening with colours reversed
+    slot.pair = ctx.nextPair++;
+    slot.opening = -1;
+    slot.startFen = start_position;
+    if (ctx.book) slot.startFen = nextOpening(*ctx.book, slot.pair, slot.opening);
+    slot.halfPoints = 0;
+    slot.pairComplete = true;
+    startGame(ctx, slot, slot.pair * 2);
+}
+
+// Benches main, then search, so a slot never runs two benches at once; all slots bench at
+// the same time, which loads the machine as the games will
+static void calibrateSlot(MatchContext &ctx, GameSlot &slot) {
+    slot.phase = phaseCalibrating;
+    for (UCIEngine &engine : slot.engines) {
+        if (engine.failed || engine.benchNps > 0) continue;
+        sendLine(engine, "bench");
+        expectReply(engine, waitBench, 300000);
+        return;
+    }
+    slot.phase = phaseCalibrated;
+
+    for (GameSlot &other : ctx.slots)
+        if (other.phase != phaseCalibrated && other.phase != phaseIdle) return;
+
+    // One factor for both engines, so a slower build still loses time against a faster one
+    long long total[2] = {0, 0};
+    int count[2] = {0, 0};
+    for (GameSlot &other : ctx.slots)
+        for (UCIEngine &engine : other.engines)
+            if (engine.benchNps > 0) {
+                total[engine.role] += engine.benchNps;
+                count[engine.role]++;
             }
-            sideToMove = gameBoard.sideToMove;
+    if (count[0] && count[1]) {
+        double mainNps = (double)total[0] / count[0], searchNps = (double)total[1] / count[1];
+        double factor = ctx.referenceNps / ((mainNps + searchNps) / 2.0);
+        TimeControl &tc = ctx.tc;
+        tc.movetimeMs = std::max(1, (int)std::lround(tc.movetimeMs * factor));
+        tc.baseMs = (int)std::lround(tc.baseMs * factor);
+        tc.incrementMs = (int)std::lround(tc.incrementMs * factor);
+
+        std::cout << std::fixed << std::setprecision(0) << "Calibration: main " << mainNps / 1000.0 << " knps, search "
+                  << searchNps / 1000.0 << " knps, reference " << ctx.referenceNps / 1000.0 << " knps | time x"
+                  << std::setprecision(2) << factor << " -> ";
+        if (tc.baseMs > 0) std::cout << tc.baseMs / 1000.0 << "+" << tc.incrementMs / 1000.0 << "s";
+        else std::cout << "movetime " << tc.movetimeMs << "ms";
+        std::cout << std::defaultfloat << std::setprecision(6) << "\n\n";
+    } else {
+        std::cout << "Calibration: no bench result for one of the engines, time control unchanged\n\n";
+    }
+    for (GameSlot &other : ctx.slots)
+        if (other.phase == phaseCalibrated) startNextPair(ctx, other);
+}
+
+// Checks for the end of the game, then asks the side to move for its move: position and
+// isready first, go once readyok is back so the measured time is the engine's own
+static void requestMove(MatchContext &ctx, GameSlot &slot) {
+    Board *pos = &slot.board;
+    if (countLegalMoves(pos) == 0) {
+        bool mated = isBoardInCheck(pos);
+        slot.resultNote = mated ? "checkmate" : "stalemate";
+        return finishGame(ctx, slot, !mated ? DRAW : pos->sideToMove == white ? BLACK_WIN : WHITE_WIN);
+    }
+    if (ctx.stopRequested) return finishGame(ctx, slot, ABORT);
+
+    int sideToMove = slot.board.sideToMove;
+    UCIEngine &engine = sideToMove == white ? whiteEngineOf(slot) : blackEngineOf(slot);
+    std::string posCmd = "position fen " + slot.startFen;
+    if (!slot.moves.empty()) {
+        posCmd += " moves";
+        for (const auto &m : slot.moves) posCmd += " " + m;
+    }
+    sendLine(engine, posCmd);
+    sendLine(engine, "isready");
+    expectReply(engine, waitReadyOk, 5000);
+
+    // With a clock the reply is due the moment the flag falls
+    engine.goCommand = "go " + goParams(ctx.tc, slot.clock);
+    engine.goTimeoutMs = ctx.tc.baseMs > 0 ? (int)std::max(0LL, slot.clock.remainingMs[sideToMove] + ctx.tc.marginMs + 1)
+                                           : ctx.tc.movetimeMs + 10000;
+}
+
+// Called after every move that did not end the game by the rules; takes the mover's last
+// reported score and returns true with *result set once an adjudication rule fires
+static bool adjudicate(MatchContext &ctx, GameSlot &slot, const UCIEngine &mover, int moverColour, GameResult *result) {
+    const AdjudicationConfig &rules = ctx.adjudication;
+    if (isDeadMaterial(&slot.board)) {
+        slot.adjudication = adjudicatedMaterial;
+        slot.resultNote = "insufficient material";
+        *result = DRAW;
+        return true;
+    }
+    if (!mover.info.hasScore) {
+        slot.resignPlies = slot.drawPlies = 0;
+        return false;
+    }
+
+    // Consecutive plies come from alternating engines, so a run of 2 * moves is both agreeing
+    int whiteScore = moverColour == white ? mover.info.score : -mover.info.score;
+    bool winning = std::abs(whiteScore) >= rules.resignScore;
+    bool sameSide = slot.resignPlies > 0 && (whiteScore > 0) == (slot.lastWhiteScore > 0);
+    slot.resignPlies = !winning ? 0 : sameSide ? slot.resignPlies + 1 : 1;
+    slot.lastWhiteScore = whiteScore;
+    bool level = (int)slot.moves.size() >= 2 * rules.drawAfter && std::abs(whiteScore) <= rules.drawScore;
+    slot.drawPlies = level ? slot.drawPlies + 1 : 0;
+
+    if (rules.resignMoves > 0 && slot.resignPlies >= 2 * rules.resignMoves) {
+        slot.adjudication = adjudicatedResign;
+        slot.resultNote = "resign adjudication";
+        *result = whiteScore > 0 ? WHITE_WIN : BLACK_WIN;
+        return true;
+    }
+    if (rules.drawMoves > 0 && slot.drawPlies >= 2 * rules.drawMoves) {
+        slot.adjudication = adjudicatedDraw;
+        slot.resultNote = "draw adjudication";
+        *result = DRAW;
+        return true;
+    }
+    return false;
+}
+
+static void recordTelemetry(EngineTelemetry &telemetry, const SearchInfo &info, long long elapsedMs) {
+    telemetry.moveMs.push_back((int)elapsedMs);
+    if (!info.hasScore) return;
+    telemetry.nodes += info.nodes;
+    telemetry.searchMs += info.timeMs;
+    telemetry.depthSum += info.depth;
+    telemetry.reportedMoves++;
+}
+
+// "{eval/depth time nodes nps}" with the eval from the mover's side, as PGN viewers expect
+static std::string moveComment(const SearchInfo &info, long long elapsedMs) {
+    std::ostringstream oss;
+    oss << std::fixed << "{";
+    if (info.hasScore) {
+        int score = info.score;
+        if (std::abs(score) > infoMateScore - 1000)
+            oss << (score > 0 ? "+M" : "-M") << infoMateScore - std::abs(score);
+        else
+            oss << std::showpos << std::setprecision(2) << score / 100.0 << std::noshowpos;
+        oss << "/" << info.depth << " ";
+    }
+    oss << std::setprecision(3) << elapsedMs / 1000.0 << "s";
+    if (info.hasScore) oss << " " << info.nodes << " nodes " << info.nps << " nps";
+    oss << "}";
+    return oss.str();
+}
+
+static void handleBestmove(MatchContext &ctx, GameSlot &slot, const std::string &line, long long elapsedMs) {
+    const TimeControl &tc = ctx.tc;
+    int sideToMove = slot.board.sideToMove;
+    slot.clock.usedMs[sideToMove] += elapsedMs;
+    slot.clock.moves[sideToMove]++;
+
+    if (tc.baseMs > 0) {
+        slot.clock.remainingMs[sideToMove] -= elapsedMs;
+        if (slot.clock.remainingMs[sideToMove] < -tc.marginMs) {
+            slot.clock.flagged = sideToMove;
+            slot.resultNote = "time forfeit";
+            return finishGame(ctx, slot, sideToMove == white ? BLACK_WIN : WHITE_WIN);
+        }
+        slot.clock.remainingMs[sideToMove] += tc.incrementMs;
+    }
+
+    std::string uciMove = extractBestmove(line);
+    if (uciMove.empty() || uciMove == "0000" || uciMove == "(none)")
+        return finishGame(ctx, slot, ABORT);
+
+    int move = parseMoveStr(&slot.board, uciMove);
+    if (!move) {
+        slot.resultNote = "illegal move " + uciMove;
+        return finishGame(ctx, slot, ABORT);
+    }
+    const UCIEngine &mover = sideToMove == white ? whiteEngineOf(slot) : blackEngineOf(slot);
+    recordTelemetry(ctx.totals.telemetry[mover.role], mover.info, elapsedMs);
+    if (ctx.pgn) slot.pgnMoves.push_back(moveToSAN(&slot.board, move) + " " + moveComment(mover.info, elapsedMs));
+
+    StateInfo undo;
+    pushGameHistory(&slot.history, slot.board.zobristHash);
+    makeMoveUnchecked(&slot.board, move, &undo);
+    slot.moves.push_back(uciMove);
+
+    if (isThreefoldRepetition(&slot.board, &slot.history)) {
+        slot.resultNote = "threefold repetition";
+        return finishGame(ctx, slot, DRAW);
+    }
+    if (slot.board.halfMoveClock >= 100) {
+        slot.resultNote = "50-move rule";
+        return finishGame(ctx, slot, DRAW);
+    }
+    GameResult adjudicated;
+    if (adjudicate(ctx, slot, mover, sideToMove, &adjudicated)) return finishGame(ctx, slot, adjudicated);
+    requestMove(ctx, slot);
+}
+
+// Appends a finished game to the PGN file, flushed so the file can be watched mid-run
+static void writePgnGame(MatchContext &ctx, GameSlot &slot) {
+    std::ofstream &pgn = *ctx.pgn;
+    bool mainWhite = (slot.game % 2 == 0);
+    const char *result = slot.result == WHITE_WIN ? "1-0" : slot.result == BLACK_WIN ? "0-1"
+                       : slot.result == DRAW ? "1/2-1/2" : "*";
+    char date[16];
+    time_t now = time(nullptr);
+    strftime(date, sizeof(date), "%Y.%m.%d", localtime(&now));
+
+    pgn << "[Event \"Polarity match\"]\n[Site \"?\"]\n[Date \"" << date << "\"]\n"
+        << "[Round \"" << slot.pair + 1 << "." << slot.game % 2 + 1 << "\"]\n"
+        << "[White \"" << ctx.enginePaths[mainWhite ? 0 : 1] << "\"]\n"
+        << "[Black \"" << ctx.enginePaths[mainWhite ? 1 : 0] << "\"]\n"
+        << "[Result \"" << result << "\"]\n";
+    if (slot.startFen != start_position) pgn << "[FEN \"" << slot.startFen << "\"]\n[SetUp \"1\"]\n";
+    if (ctx.tc.baseMs > 0) pgn << "[TimeControl \"" << ctx.tc.baseMs / 1000.0 << "+" << ctx.tc.incrementMs / 1000.0 << "\"]\n";
+    pgn << "[PlyCount \"" << slot.pgnMoves.size() << "\"]\n";
+    if (!slot.resultNote.empty()) pgn << "[Termination \"" << slot.resultNote << "\"]\n";
+    pgn << "\n";
+
+    // Move text wrapped at 80 columns; a game from black to move starts with "n..."
+    std::istringstream fen(slot.startFen);
+    std::string field, side;
+    fen >> field >> side;
+    int moveNumber = fenFullMoveNumber(slot.startFen);
+    bool whiteToMove = side != "b";
+    std::string line;
+    auto emit = [&](const std::string &token) {
+        if (!line.empty() && line.size() + 1 + token.size() > 80) {
+            pgn << line << "\n";
+            line.clear();
         }
-        if (gameOver) return terminal;
+        line += (line.empty() ? "" : " ") + token;
+    };
+    for (size_t i = 0; i < slot.pgnMoves.size(); ++i) {
+        if (whiteToMove) emit(std::to_string(moveNumber) + ".");
+        else if (i == 0) emit(std::to_string(moveNumber) + "...");
+        std::istringstream parts(slot.pgnMoves[i]);
+        std::string token;
+        while (parts >> token) emit(token);
+        if (!whiteToMove) moveNumber++;
+        whiteToMove = !whiteToMove;
+    }
+    emit(result);
+    pgn << line << "\n\n" << std::flush;
+}
+
+static void recordOutcome(MatchContext &ctx, GameSlot &slot) {
+    MatchTotals &totals = ctx.totals;
+    bool mainWhite = (slot.game % 2 == 0);
+    const char *whiteName = mainWhite ? "main" : "search";
+    const char *blackName = mainWhite ? "search" : "main";
 
-        UCIEngine &engine = (sideToMove == white) ? whiteEngine : blackEngine;
-        std::string posCmd = "position startpos";
-        if (!moveHistory.empty()) {
-            posCmd += " moves";
-            for (const auto &m : moveHistory) posCmd += " " + m;
+    int mainColour = mainWhite ? white : black;
+    totals.mainMoves += slot.clock.moves[mainColour];
+    totals.searchMoves += slot.clock.moves[mainColour ^ 1];
+    totals.mainTimeMs += slot.clock.usedMs[mainColour];
+    totals.searchTimeMs += slot.clock.usedMs[mainColour ^ 1];
+    if (slot.clock.flagged >= 0) (slot.clock.flagged == mainColour ? totals.mainFlags : totals.searchFlags)++;
+    if (slot.result != ABORT) {
+        int plies = (int)slot.moves.size();
+        totals.totalPlies += plies;
+        totals.adjudicated[slot.adjudication]++;
+        if (slot.adjudication != adjudicatedNone) {
+            totals.adjudicatedPlies.push_back(plies);
+        } else {
+            totals.naturalPlies.push_back(plies);
         }
-        engine.cmd(posCmd);
+    }
 
-        std::string response = engine.bestmove(movetimeMs);
-        std::string uciMove = extractBestmove(response);
-        if (uciMove.empty() || uciMove == "0000" || uciMove == "(none)")
-            return ABORT;
+    std::ostringstream oss;
+    oss << "Game " << (slot.game + 1) << ": " << whiteName << " (W) vs " << blackName << " (B) | ";
+    if (slot.opening >= 0) oss << "opening " << slot.opening + 1 << " | ";
+    oss << slot.moves.size() << " plies | ";
 
-        {
-            std::lock_guard<std::mutex> lock(boardMutex);
-            int move = parseMoveStr(&gameBoard, uciMove);
-            if (!move) return ABORT;
+    int mainPoint = 0;
+    if (slot.result == WHITE_WIN || slot.result == BLACK_WIN) {
+        bool mainWon = (slot.result == WHITE_WIN) == mainWhite;
+        (mainWon ? totals.mainWins : totals.searchWins)++;
+        mainPoint = mainWon ? 1 : -1;
+        oss << (mainWon ? "main wins" : "search wins");
+        if (slot.resultNote != "checkmate") oss << " (" << slot.resultNote << ")";
+    } else if (slot.result == DRAW) {
+        totals.draws++;
+        oss << "draw";
+        if (!slot.resultNote.empty()) oss << " (" << slot.resultNote << ")";
+    } else if (ctx.stopRequested) {
+        slot.pairComplete = false;
+        oss << "stopped";
+    } else {
+        totals.aborted++;
+        slot.pairComplete = false;
+        oss << "aborted";
+        if (!slot.resultNote.empty()) oss << " (" << slot.resultNote << ")";
+    }
+    slot.halfPoints += mainPoint + 1;
+    std::cout << oss.str() << std::endl;
+    if (ctx.pgn && (slot.result != ABORT || !ctx.stopRequested)) writePgnGame(ctx, slot);
+}
 
-            if (!makeMove(&gameBoard, move)) return ABORT;
+// Aborts every game in progress; the engines finish or abandon their current reply first
+static void stopAllGames(MatchContext &ctx) {
+    ctx.stopRequested = true;
+    for (GameSlot &slot : ctx.slots)
+        if (slot.phase == phaseNewGame || slot.phase == phasePlaying) finishGame(ctx, slot, ABORT);
+}
 
-            positionHistory.push_back(gameBoard.zobristHash);
-            if (countPositionOccurrences(gameBoard.zobristHash, positionHistory) >= 3) {
-                resultNote = "threefold repetition";
-                return DRAW;
-            }
+static void finishPair(MatchContext &ctx, GameSlot &slot) {
+    if (!slot.pairComplete) return;
+    ctx.penta.counts[slot.halfPoints]++;
+    MatchStats stats = pentanomialStats(ctx.penta, ctx.sprt);
+    std::cout << "  " << formatStats(ctx.penta, stats, ctx.sprt) << std::endl;
+    if (ctx.sprt.enabled && !ctx.stopRequested) {
+        if (stats.llr >= sprtUpperBound(ctx.sprt)) ctx.sprtVerdict = "H1 accepted (elo1 is the better fit)";
+        else if (stats.llr <= sprtLowerBound(ctx.sprt)) ctx.sprtVerdict = "H0 accepted (elo0 is the better fit)";
+        if (!ctx.sprtVerdict.empty()) stopAllGames(ctx);
+    }
+}
 
-            if (gameBoard.halfMoveClock >= 100) {
-                resultNote = "50-move rule";
-                return DRAW;
-            }
+static void finishGame(MatchContext &ctx, GameSlot &slot, GameResult result) {
+    slot.result = result;
+    slot.phase = phaseFinishing;
+    recordOutcome(ctx, slot);
+
+    // An engine still thinking is told to stop, and its bestmove is dropped when it comes
+    for (UCIEngine &engine : slot.engines) {
+        engine.goCommand.clear();
+        if (engine.waiting == waitBestmove && !engine.draining) {
+            sendLine(engine, "stop");
+            engine.draining = true;
+            expectReply(engine, waitBestmove, 5000);
         }
+    }
+    advanceSlot(ctx, slot);
+}
 
-        moveHistory.push_back(uciMove);
+// Called whenever one of the slot's engines has nothing left to answer
+static void advanceSlot(MatchContext &ctx, GameSlot &slot) {
+    for (UCIEngine &engine : slot.engines)
+        if (engine.waiting != waitNone) return;
+
+    switch (slot.phase) {
+        case phaseLaunching:
+        case phaseCalibrating:
+            if (ctx.referenceNps > 0) calibrateSlot(ctx, slot);
+            else startNextPair(ctx, slot);
+            break;
+        case phaseNewGame:
+            if (slot.engines[0].failed || slot.engines[1].failed) return finishGame(ctx, slot, ABORT);
+            slot.phase = phasePlaying;
+            requestMove(ctx, slot);
+            break;
+        case phaseFinishing:
+            if (slot.game % 2 == 0 && slot.pairComplete && !ctx.stopRequested)
+                return startGame(ctx, slot, slot.game + 1);
+            // A stop that arrived while the first game was still draining leaves half a pair
+            if (slot.game % 2 == 0) slot.pairComplete = false;
+            finishPair(ctx, slot);
+            startNextPair(ctx, slot);
+            break;
+        default:
+            break;
     }
 }
 
-struct GameOutcome {
-    int gameNum = 0;
-    int plies = 0;
-    int mainPoint = 0;   // 1 win, 0 draw, -1 loss
-    bool aborted = false;
-    std::string line;
-};
+static void failEngine(MatchContext &ctx, GameSlot &slot, UCIEngine &engine, const std::string &reason) {
+    if (engine.failed) return;
+    std::cerr << "Engine " << ctx.enginePaths[engine.role] << " (slot " << engine.slot + 1 << ") " << reason << "\n";
+    engine.failed = true;
+    engine.waiting = waitNone;
+    engine.draining = false;
+    epoll_ctl(ctx.epollFd, EPOLL_CTL_DEL, engine.outFd, nullptr);
+    if (engine.pid > 0) kill(engine.pid, SIGKILL);
 
-struct MatchTotals {
-    std::atomic<int> mainWins{0};
-    std::atomic<int> searchWins{0};
-    std::atomic<int> draws{0};
-    std::atomic<int> aborted{0};
-};
+    if (slot.phase == phaseNewGame || slot.phase == phasePlaying) {
+        slot.resultNote = "engine " + reason;
+        finishGame(ctx, slot, ABORT);
+    } else {
+        advanceSlot(ctx, slot);
+    }
+}
 
-static void matchWorker(const char *mainPath, const char *searchPath, int movetime, int totalGames,
-                        int parallelism, std::atomic<int> &nextGame, MatchTotals &totals,
-                        std::vector<GameOutcome> &outcomes, std::mutex &outcomeMutex) {
-    UCIEngine mainEngine, searchEngine;
-    if (!mainEngine.launch(mainPath) || !searchEngine.launch(searchPath)) {
-        std::cerr << "Worker failed to launch engines\n";
+static void handleLine(MatchContext &ctx, GameSlot &slot, UCIEngine &engine, const std::string &line) {
+    if (line.rfind("info", 0) == 0) {
+        if (engine.waiting == waitBestmove && !engine.draining) parseInfoLine(line, &engine.info);
         return;
     }
-    mainEngine.cmd("uci"); mainEngine.drainUntil("uciok", 3000);
-    searchEngine.cmd("uci"); searchEngine.drainUntil("uciok", 3000);
 
+    if (engine.waiting == waitUciOk && line.rfind("uciok", 0) == 0) {
+        engine.waiting = waitNone;
+        advanceSlot(ctx, slot);
+    } else if (engine.waiting == waitReadyOk && line.rfind("readyok", 0) == 0) {
+        engine.waiting = waitNone;
+        if (!engine.goCommand.empty()) {
+            sendLine(engine, engine.goCommand);
+            engine.goCommand.clear();
+            engine.goSentAt = steadyMilliseconds();
+            engine.info = SearchInfo();
+            expectReply(engine, waitBestmove, engine.goTimeoutMs);
+            return;
+        }
+        advanceSlot(ctx, slot);
+    } else if (engine.waiting == waitBench && line.rfind("Nodes/second:", 0) == 0) {
+        engine.waiting = waitNone;
+        engine.benchNps = std::max(1LL, std::atoll(line.c_str() + 13));
+        advanceSlot(ctx, slot);
+    } else if (engine.waiting == waitBestmove && line.rfind("bestmove", 0) == 0) {
+        engine.waiting = waitNone;
+        if (engine.draining) {
+            engine.draining = false;
+            return advanceSlot(ctx, slot);
+        }
+        handleBestmove(ctx, slot, line, steadyMilliseconds() - engine.goSentAt);
+    }
+}
+
+// A missed bestmove deadline under a clock is a flag-fall: the game is lost on the spot and
+// the engine is stopped. Any other missed reply means the engine is gone or hung.
+static void handleTimeout(MatchContext &ctx, GameSlot &slot, UCIEngine &engine) {
+    if (engine.waiting == waitBestmove && !engine.draining && ctx.tc.baseMs > 0 && slot.phase == phasePlaying) {
+        handleBestmove(ctx, slot, "", steadyMilliseconds() - engine.goSentAt);
+        return;
+    }
+    const char *reason = engine.waiting == waitUciOk ? "did not answer uci"
+                       : engine.waiting == waitReadyOk ? "did not answer isready"
+                       : engine.waiting == waitBench ? "did not finish bench"
+                       : engine.draining ? "did not stop" : "did not answer go";
+    failEngine(ctx, slot, engine, reason);
+}
+
+static void readEngineOutput(MatchContext &ctx, UCIEngine &engine) {
+    GameSlot &slot = ctx.slots[engine.slot];
+    char buf[4096];
+    while (!engine.failed) {
+        ssize_t n = read(engine.outFd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return; // EAGAIN: everything available has been read
+        if (n == 0) return failEngine(ctx, slot, engine, "exited");
+
+        engine.partialLine.append(buf, (size_t)n);
+        size_t start = 0, newline;
+        while ((newline = engine.partialLine.find('\n', start)) != std::string::npos) {
+            std::string line = engine.partialLine.substr(start, newline - start);
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            start = newline + 1;
+            handleLine(ctx, slot, engine, line);
+            if (engine.failed) return;
+        }
+        engine.partialLine.erase(0, start);
+    }
+}
+
+static void runMatch(MatchContext &ctx) {
+    ctx.epollFd = epoll_create1(EPOLL_CLOEXEC);
+    for (size_t s = 0; s < ctx.slots.size(); ++s) {
+        GameSlot &slot = ctx.slots[s];
+        for (int role = 0; role < 2; ++role) {
+            UCIEngine &engine = slot.engines[role];
+            engine.slot = (int)s;
+            engine.role = role;
+            if (!launchEngine(engine, ctx.enginePaths[role], ctx.pinCpus.empty() ? -1 : ctx.pinCpus[s])) {
+                std::cerr << "Slot " << s + 1 << " failed to launch " << ctx.enginePaths[role] << "\n";
+                engine.failed = true;
+                continue;
+            }
+            epoll_event event = {};
+            event.events = EPOLLIN;
+            event.data.ptr = &engine;
+            epoll_ctl(ctx.epollFd, EPOLL_CTL_ADD, engine.outFd, &event);
+            sendLine(engine, "uci");
+            if (ctx.hashMB > 0) sendLine(engine, "setoption name Hash value " + std::to_string(ctx.hashMB));
+            expectReply(engine, waitUciOk, 3000);
+        }
+    }
+    for (GameSlot &slot : ctx.slots) advanceSlot(ctx, slot);
+
+    std::vector<epoll_event> events(64);
     while (true) {
-        int g = nextGame.fetch_add(1);
-        if (g >= totalGames) break;
-
-        bool mainWhite = (g % 2 == 0);
-        UCIEngine &whiteEngine = mainWhite ? mainEngine : searchEngine;
-        UCIEngine &blackEngine = mainWhite ? searchEngine : mainEngine;
-        const char *whiteName = mainWhite ? "main" : "search";
-        const char *blackName = mainWhite ? "search" : "main";
-
-        std::vector<std::string> moves;
-        std::string resultNote;
-        GameResult result = playGame(whiteEngine, blackEngine, movetime, moves, resultNote);
-
-        GameOutcome outcome;
-        outcome.gameNum = g + 1;
-        outcome.plies = (int)moves.size();
-
-        std::ostringstream oss;
-        oss << "Game " << (g + 1) << ": " << whiteName << " (W) vs " << blackName << " (B) | "
-            << moves.size() << " plies | ";
-
-        if (result == WHITE_WIN) {
-            if (mainWhite) { totals.mainWins++; outcome.mainPoint = 1; oss << "main wins"; }
-            else { totals.searchWins++; outcome.mainPoint = -1; oss << "search wins"; }
-        } else if (result == BLACK_WIN) {
-            if (mainWhite) { totals.searchWins++; outcome.mainPoint = -1; oss << "search wins"; }
-            else { totals.mainWins++; outcome.mainPoint = 1; oss << "main wins"; }
-        } else if (result == DRAW) {
-            totals.draws++;
-            outcome.mainPoint = 0;
-            oss << "draw";
-            if (!resultNote.empty()) oss << " (" << resultNote << ")";
-        } else {
-            totals.aborted++;
-            outcome.aborted = true;
-            oss << "aborted";
+        long long nextDeadline = LLONG_MAX;
+        for (GameSlot &slot : ctx.slots)
+            for (UCIEngine &engine : slot.engines)
+                if (engine.waiting != waitNone) nextDeadline = std::min(nextDeadline, engine.deadline);
+        if (nextDeadline == LLONG_MAX) break; // every slot is idle
+
+        long long wait = std::max(0LL, nextDeadline - steadyMilliseconds());
+        int ready = epoll_wait(ctx.epollFd, events.data(), (int)events.size(), (int)std::min(wait, (long long)INT_MAX));
+        if (ready < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            break;
         }
+        for (int i = 0; i < ready; ++i)
+            readEngineOutput(ctx, *(UCIEngine *)events[i].data.ptr);
 
-        outcome.line = oss.str();
+        long long now = steadyMilliseconds();
+        for (GameSlot &slot : ctx.slots)
+            for (UCIEngine &engine : slot.engines)
+                if (engine.waiting != waitNone && engine.deadline <= now) handleTimeout(ctx, slot, engine);
+    }
 
-        {
-            std::lock_guard<std::mutex> lock(outcomeMutex);
-            outcomes[g] = outcome;
-            std::cout << outcome.line << std::endl;
+    for (GameSlot &slot : ctx.slots)
+        for (UCIEngine &engine : slot.engines) {
+            if (engine.pid <= 0) continue;
+            sendLine(engine, "quit");
+            close(engine.inFd);
+        }
+    for (GameSlot &slot : ctx.slots)
+        for (UCIEngine &engine : slot.engines) {
+            if (engine.pid <= 0) continue;
+            waitpid(engine.pid, nullptr, 0);
+            close(engine.outFd);
         }
+    close(ctx.epollFd);
+}
+
+// Nearest-rank percentile of an already sorted list
+static int percentile(const std::vector<int> &sorted, double fraction) {
+    if (sorted.empty()) return 0;
+    size_t rank = (size_t)std::ceil(fraction * sorted.size());
+    return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+// Search speed and depth from the engines' own reports, and how the wall time per move is
+// spread, so a slower build shows up even when the Elo difference is still noise
+static void printTelemetry(MatchTotals &totals) {
+    const char *names[2] = {"main", "search"};
+    std::cout << std::fixed << std::setprecision(1);
+    for (int role = 0; role < 2; ++role) {
+        EngineTelemetry &telemetry = totals.telemetry[role];
+        std::sort(telemetry.moveMs.begin(), telemetry.moveMs.end());
+        double knps = telemetry.searchMs > 0 ? (double)telemetry.nodes / telemetry.searchMs : 0.0;
+        double depth = telemetry.reportedMoves ? (double)telemetry.depthSum / telemetry.reportedMoves : 0.0;
+        std::cout << (role == 0 ? "Search: " : "        ") << std::left << std::setw(7) << names[role] << std::right
+                  << knps << " knps, depth " << depth << " | move ms p50 " << percentile(telemetry.moveMs, 0.5)
+                  << " p90 " << percentile(telemetry.moveMs, 0.9) << " p99 " << percentile(telemetry.moveMs, 0.99)
+                  << " max " << (telemetry.moveMs.empty() ? 0 : telemetry.moveMs.back()) << "\n";
     }
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
 
-    mainEngine.shutdown();
-    searchEngine.shutdown();
+// An adjudicated game is assumed to have lasted as long as the average game that ended on the
+// board after reaching the same ply, and each ply saved is worth the match's measured wall
+// time per ply
+static void printAdjudicationSavings(const MatchTotals &totals, long long elapsedMs) {
+    if (totals.adjudicatedPlies.empty()) return;
+    std::cout << "Adjudicated: " << totals.adjudicated[adjudicatedResign] << " resign, "
+              << totals.adjudicated[adjudicatedDraw] << " draw, "
+              << totals.adjudicated[adjudicatedMaterial] << " insufficient material";
+
+    // Games that ended on the board before the adjudication ply say nothing about how long an
+    // adjudicated game would have gone on, so only the ones that got at least as far count
+    double pliesSaved = 0;
+    int estimated = 0;
+    for (int plies : totals.adjudicatedPlies) {
+        long long survivorPlies = 0;
+        int survivors = 0;
+        for (int natural : totals.naturalPlies)
+            if (natural >= plies) {
+                survivorPlies += natural;
+                survivors++;
+            }
+        if (!survivors) continue;
+        pliesSaved += (double)survivorPlies / survivors - plies;
+        estimated++;
+    }
+    if (estimated == 0 || totals.totalPlies == 0) {
+        std::cout << " | no game ended on the board after the adjudication ply, so the time saved cannot be estimated\n";
+        return;
+    }
+
+    double savedMs = pliesSaved * elapsedMs / totals.totalPlies;
+    std::cout << std::fixed << std::setprecision(1) << " | ~" << pliesSaved << " plies, ~" << savedMs / 1000.0
+              << " s wall-clock saved (" << 100.0 * savedMs / (elapsedMs + savedMs) << "% of the unadjudicated run)";
+    if (estimated < (int)totals.adjudicatedPlies.size())
+        std::cout << ", from " << estimated << " of " << totals.adjudicatedPlies.size()
+                  << " adjudications; no game ended on the board after the others";
+    std::cout << "\n" << std::defaultfloat << std::setprecision(6);
 }
 
+// Usage: match [main] [search] [games] [movetime] [concurrency] [elo0 elo1 [alpha beta]]
+//              [--openings file] [--order sequential|random] [--seed n] [--tc base+inc] [--margin ms]
+//              [--hash mb] [--resign score moves] [--draw score moves after] [--pgn file]
+//              [--calibrate nps] [--pin]
+// Giving elo0/elo1 turns on SPRT: games is then only the upper limit, and the run stops as
+// soon as the LLR leaves (log(beta / (1 - alpha)), log((1 - beta) / alpha)). --tc takes
+// seconds (e.g. 10+0.1) and replaces the fixed movetime with real clocks. --resign and --draw
+// turn on score adjudication (see AdjudicationConfig); dead material always ends a game.
+// --pgn appends every game, with the engine's eval, depth, time, nodes and nps on each move.
+// --calibrate runs each engine's bench first and scales the time control by the reference
+// nps over the measured one. Concurrency is capped at the physical cores this process may
+// use, and --pin gives every slot's engines a core of their own.
 int main(int argc, char **argv) {
-    const char *mainPath = (argc > 1) ? argv[1] : "./engine-main";
-    const char *searchPath = (argc > 2) ? argv[2] : "./engine-search";
-    int games = (argc > 3) ? std::stoi(argv[3]) : 10;
-    int movetime = (argc > 4) ? std::stoi(argv[4]) : 500;
-    int parallelism = (argc > 5) ? std::stoi(argv[5]) : 4;
+    std::vector<std::string> args;
+    std::string openingsPath, order = "sequential", timeControl, pgnPath;
+    int marginMs = 50, hashMB = 0;
+    long long referenceNps = 0;
+    bool pin = false;
+    AdjudicationConfig adjudication;
+    uint64_t seed = (uint64_t)TIME_IN_MILLISECONDS;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--openings" && i + 1 < argc) openingsPath = argv[++i];
+        else if (arg == "--order" && i + 1 < argc) order = argv[++i];
+        else if (arg == "--seed" && i + 1 < argc) seed = std::stoull(argv[++i]);
+        else if (arg == "--tc" && i + 1 < argc) timeControl = argv[++i];
+        else if (arg == "--margin" && i + 1 < argc) marginMs = std::stoi(argv[++i]);
+        else if (arg == "--hash" && i + 1 < argc) hashMB = std::stoi(argv[++i]);
+        else if (arg == "--pgn" && i + 1 < argc) pgnPath = argv[++i];
+        else if (arg == "--calibrate" && i + 1 < argc) referenceNps = std::stoll(argv[++i]);
+        else if (arg == "--pin") pin = true;
+        else if (arg == "--resign" && i + 2 < argc) {
+            adjudication.resignScore = std::stoi(argv[++i]);
+            adjudication.resignMoves = std::stoi(argv[++i]);
+        } else if (arg == "--draw" && i + 3 < argc) {
+            adjudication.drawScore = std::stoi(argv[++i]);
+            adjudication.drawMoves = std::stoi(argv[++i]);
+            adjudication.drawAfter = std::stoi(argv[++i]);
+        }
+        else args.push_back(arg);
+    }
+    if (order != "sequential" && order != "random") {
+        std::cerr << "Unknown opening order " << order << " (sequential or random)\n";
+        return 1;
+    }
+
+    const char *mainPath = (args.size() > 0) ? args[0].c_str() : "./engine-main";
+    const char *searchPath = (args.size() > 1) ? args[1].c_str() : "./engine-search";
+    int games = (args.size() > 2) ? std::stoi(args[2]) : 10;
+    int movetime = (args.size() > 3) ? std::stoi(args[3]) : 500;
+    int concurrency = (args.size() > 4) ? std::stoi(args[4]) : 4;
+
+    TimeControl tc;
+    tc.movetimeMs = movetime;
+    tc.marginMs = std::max(0, marginMs);
+    if (!timeControl.empty()) {
+        size_t plus = timeControl.find('+');
+        tc.baseMs = (int)(std::stod(timeControl.substr(0, plus)) * 1000.0);
+        tc.incrementMs = plus == std::string::npos ? 0 : (int)(std::stod(timeControl.substr(plus + 1)) * 1000.0);
+        if (tc.baseMs <= 0) {
+            std::cerr << "Time control needs a positive base time\n";
+            return 1;
+        }
+    }
+
+    SprtConfig sprt;
+    if (args.size() > 6) {
+        sprt.enabled = true;
+        sprt.elo0 = std::stod(args[5]);
+        sprt.elo1 = std::stod(args[6]);
+        if (args.size() > 8) {
+            sprt.alpha = std::stod(args[7]);
+            sprt.beta = std::stod(args[8]);
+        }
+        if (sprt.elo1 <= sprt.elo0 || sprt.alpha <= 0 || sprt.alpha >= 1 || sprt.beta <= 0 || sprt.beta >= 1) {
+            std::cerr << "SPRT needs elo0 < elo1 and 0 < alpha, beta < 1\n";
+            return 1;
+        }
+    }
 
-    if (parallelism < 1) parallelism = 1;
-    if (parallelism > games) parallelism = games;
+    // Games are played in colour-swapped pairs
+    int pairs = std::max(1, (games + 1) / 2);
+    games = pairs * 2;
+    if (concurrency < 1) concurrency = 1;
+    if (concurrency > pairs) concurrency = pairs;
+
+    // Only one engine of a slot thinks at a time, so a slot needs one core; more slots than
+    // physical cores would have engines sharing a core and skew every timed move
+    std::vector<int> cores = physicalCores();
+    if (!cores.empty() && concurrency > (int)cores.size()) {
+        std::cout << "Concurrency capped at " << cores.size() << " (physical cores available)\n";
+        concurrency = (int)cores.size();
+    }
+
+    // A write to an engine that has just died must not take the runner down with it
+    signal(SIGPIPE, SIG_IGN);
 
     initializeMoveTables();
     initializeRandomKeys();
@@ -301,33 +1213,89 @@ int main(int argc, char **argv) {
     initializeEvaluationMasks();
 
     std::cout << "Match: " << mainPath << " vs " << searchPath
-              << " | " << games << " games | movetime " << movetime << "ms"
-              << " | parallelism " << parallelism << "\n\n";
+              << " | " << games << " games | ";
+    if (tc.baseMs > 0) std::cout << "tc " << tc.baseMs / 1000.0 << "+" << tc.incrementMs / 1000.0 << "s (margin " << tc.marginMs << "ms)";
+    else std::cout << "movetime " << tc.movetimeMs << "ms";
+    std::cout << " | concurrency " << concurrency;
+    if (pin && !cores.empty()) std::cout << " (pinned)";
+    if (sprt.enabled)
+        std::cout << " | SPRT elo0 " << sprt.elo0 << " elo1 " << sprt.elo1
+                  << " alpha " << sprt.alpha << " beta " << sprt.beta;
+    std::cout << "\n";
+    if (adjudication.resignMoves > 0 || adjudication.drawMoves > 0) {
+        std::cout << "Adjudication:";
+        if (adjudication.resignMoves > 0)
+            std::cout << " resign at " << adjudication.resignScore << "cp for " << adjudication.resignMoves << " moves";
+        if (adjudication.resignMoves > 0 && adjudication.drawMoves > 0) std::cout << " |";
+        if (adjudication.drawMoves > 0)
+            std::cout << " draw within " << adjudication.drawScore << "cp for " << adjudication.drawMoves
+                      << " moves after move " << adjudication.drawAfter;
+        std::cout << "\n";
+    }
 
-    std::atomic<int> nextGame{0};
-    MatchTotals totals;
-    std::vector<GameOutcome> outcomes(games);
-    std::mutex outcomeMutex;
+    OpeningBook book;
+    if (!openingsPath.empty()) {
+        if (!openOpeningBook(book, openingsPath, order == "random", seed)) {
+            std::cerr << "No openings in " << openingsPath << "\n";
+            return 1;
+        }
+        std::cout << "Openings: " << openingsPath << " | " << book.offsets.size() << " positions | " << order;
+        if (order == "random") std::cout << " (seed " << seed << ")";
+        std::cout << "\n";
+    }
+    std::cout << "\n";
 
-    auto startTime = TIME_IN_MILLISECONDS;
-    std::vector<std::thread> workers;
-    workers.reserve(parallelism);
-    for (int t = 0; t < parallelism; ++t)
-        workers.emplace_back(matchWorker, mainPath, searchPath, movetime, games, parallelism,
-                             std::ref(nextGame), std::ref(totals), std::ref(outcomes), std::ref(outcomeMutex));
+    std::ofstream pgn;
+    if (!pgnPath.empty()) {
+        pgn.open(pgnPath, std::ios::app);
+        if (!pgn.is_open()) {
+            std::cerr << "Cannot write " << pgnPath << "\n";
+            return 1;
+        }
+    }
 
-    for (auto &w : workers) w.join();
+    MatchContext ctx;
+    ctx.enginePaths[0] = mainPath;
+    ctx.enginePaths[1] = searchPath;
+    ctx.tc = tc;
+    ctx.sprt = sprt;
+    ctx.adjudication = adjudication;
+    ctx.hashMB = hashMB;
+    ctx.book = openingsPath.empty() ? nullptr : &book;
+    ctx.pgn = pgnPath.empty() ? nullptr : &pgn;
+    ctx.referenceNps = std::max(0LL, referenceNps);
+    if (pin && !cores.empty()) ctx.pinCpus.assign(cores.begin(), cores.begin() + concurrency);
+    ctx.pairs = pairs;
+    ctx.slots.resize(concurrency);
+
+    auto startTime = TIME_IN_MILLISECONDS;
+    runMatch(ctx);
     auto elapsed = TIME_IN_MILLISECONDS - startTime;
 
+    MatchTotals &totals = ctx.totals;
+    int played = totals.mainWins + totals.searchWins + totals.draws;
+    MatchStats stats = pentanomialStats(ctx.penta, sprt);
+
     std::cout << "\n=== Final Score ===\n";
-    std::cout << "main:   " << totals.mainWins.load() << " / " << games << "\n";
-    std::cout << "search: " << totals.searchWins.load() << " / " << games << "\n";
-    std::cout << "draws:  " << totals.draws.load() << "\n";
-    if (totals.aborted.load()) std::cout << "aborted:" << totals.aborted.load() << "\n";
-    std::cout << "Score:  " << totals.mainWins.load() << " - " << totals.searchWins.load()
-              << " - " << totals.draws.load() << " (W-D-L from main's perspective)\n";
+    std::cout << "main:   " << totals.mainWins << " / " << played << "\n";
+    std::cout << "search: " << totals.searchWins << " / " << played << "\n";
+    std::cout << "draws:  " << totals.draws << "\n";
+    if (totals.aborted) std::cout << "aborted:" << totals.aborted << "\n";
+    std::cout << "Score:  " << totals.mainWins << " - " << totals.searchWins
+              << " - " << totals.draws << " (W-D-L from main's perspective)\n";
+    std::cout << formatStats(ctx.penta, stats, sprt) << "\n";
+    auto perMove = [](long long ms, int moves) { return moves ? (double)ms / moves : 0.0; };
+    std::cout << std::fixed << std::setprecision(1)
+              << "Time:   main " << perMove(totals.mainTimeMs, totals.mainMoves) << " ms/move, "
+              << totals.mainFlags << " flag-falls | search "
+              << perMove(totals.searchTimeMs, totals.searchMoves) << " ms/move, "
+              << totals.searchFlags << " flag-falls\n" << std::defaultfloat << std::setprecision(6);
+    printTelemetry(totals);
+    printAdjudicationSavings(totals, elapsed);
+    if (sprt.enabled)
+        std::cout << "SPRT:   " << (ctx.sprtVerdict.empty() ? "inconclusive, game limit reached" : ctx.sprtVerdict) << "\n";
     std::cout << "Elapsed: " << elapsed << " ms (" << (elapsed / 1000.0) << " s)\n";
 
-    delete[] TranspositionTable;
+    freeTranspositionTable();
     return 0;
 }
@@ -6,7 +6,7 @@
 #include "../src/precalculated_move_tables.h"
 #include "../src/moves.h"
 
-static U64 nodes = 0;
+static thread_local U64 nodes = 0; // per thread so perftValidate can run positions in parallel
 
 static inline void perft(Board *board, int depth) {
     if (depth == 0) {
@@ -15,29 +15,35 @@ static inline void perft(Board *board, int depth) {
     }
 
     MoveList moves[1];
-    generateMoves(board, moves);
-    copyBoard(board);
+    generateLegalMoves(board, moves);
 
-    for (int i = 0; i < moves->count; ++i) {
-        if (!makeMove(board, moves->moves[i])) { takeBack(board, backup); continue; }
+    // Bulk counting: every generated move is legal, so the last ply is just the list size
+    if (depth == 1) {
+        nodes += moves->count;
+        return;
+    }
 
+    StateInfo undo;
+
+    for (int i = 0; i < moves->count; ++i) {
+        makeMoveUnchecked(board, moves->moves[i], &undo);
         perft(board, depth - 1);
-        takeBack(board, backup);
+        unmakeMove(board, moves->moves[i], &undo);
     }
 }
 
 static inline int perftTest(Board *board, int depth, int verbose = 0) {
     nodes = 0;
     MoveList moves[1];
-    generateMoves(board, moves);
-    copyBoard(board);
+    generateLegalMoves(board, moves);
+    StateInfo undo;
     U64 cumNodes = 0;
     auto startTime = TIME_IN_MICROSECONDS;
     for (int i = 0; i < moves->count; ++i) {
         int move = moves->moves[i];
-        if (!makeMove(board, move)) { takeBack(board, backup); continue; }
+        makeMoveUnchecked(board, move, &undo);
         perft(board, depth - 1);
-        takeBack(board, backup);
+        unmakeMove(board, move, &undo);
         if (verbose){
             std::cout << "Move: ";
             printMove(move);
@@ -3,15 +3,17 @@
 #include <sstream>
 #include <string>
 #include <unordered_map>
+#include <vector>
 #include "../src/constants.h"
 #include "../src/board.h"
 #include "../src/precalculated_move_tables.h"
 #include "../src/moves.h"
 #include "perft.h"
+#include "threadpool.h"
 
 using namespace std;
 
-int main() {
+int main(int argc, char **argv) {
     initializeMoveTables();
 
     ifstream infile("perftSuite.txt");
@@ -20,45 +22,66 @@ int main() {
         return 1;
     }
 
+    vector<string> lines;
     string line;
-    int totalTests = 0, failedTests = 0;
-
     while (getline(infile, line)) {
-        if (line.empty()) continue;
+        if (!line.empty()) lines.push_back(line);
+    }
+
+    // Positions are independent, so they are spread over a pool and reported in file order
+    int threads = (argc > 1) ? max(1, atoi(argv[1])) : max(1, (int)thread::hardware_concurrency());
+    ThreadPool pool;
+    initializeThreadPool(&pool, threads);
 
-        stringstream ss(line);
-        string segment;
-        getline(ss, segment, ';'); // FEN is before the first semicolon
-        string fen = segment;
+    vector<string> reports(lines.size());
+    vector<int> testCounts(lines.size(), 0), failCounts(lines.size(), 0);
 
-        Board board;
-        parseFEN(&board, fen);
-        cout << "\nFEN: " << fen << "\n";
+    parallelFor(&pool, lines.size(), 1, [&](int, size_t start, size_t end) {
+        for (size_t index = start; index < end; ++index) {
+            stringstream ss(lines[index]);
+            ostringstream out;
+            string segment;
+            getline(ss, segment, ';'); // FEN is before the first semicolon
+            string fen = segment;
 
-        while (getline(ss, segment, ';')) {
-            if (segment.empty()) continue;
+            Board board;
+            parseFEN(&board, fen);
+            out << "\nFEN: " << fen << "\n";
 
-            size_t d_pos = segment.find('D');
-            if (d_pos == string::npos) continue;
+            while (getline(ss, segment, ';')) {
+                if (segment.empty()) continue;
 
-            stringstream pair_ss(segment);
-            string depth_token, val_token;
-            pair_ss >> depth_token >> val_token;
+                size_t d_pos = segment.find('D');
+                if (d_pos == string::npos) continue;
 
-            if (depth_token.size() < 2 || val_token.empty()) continue;
+                stringstream pair_ss(segment);
+                string depth_token, val_token;
+                pair_ss >> depth_token >> val_token;
 
-            int depth = stoi(depth_token.substr(1));
-            U64 expected = stoull(val_token);
-            totalTests++;
+                if (depth_token.size() < 2 || val_token.empty()) continue;
 
-            U64 result = perftTest(&board, depth);
-            if (result != expected) {
-                cout << "  X Depth " << depth << ": expected " << expected << ", got " << result << "\n";
-                failedTests++;
-            } else {
-                cout << " >> Depth " << depth << ": " << result << "\n";
+                int depth = stoi(depth_token.substr(1));
+                U64 expected = stoull(val_token);
+                testCounts[index]++;
+
+                U64 result = perftTest(&board, depth);
+                if (result != expected) {
+                    out << "  X Depth " << depth << ": expected " << expected << ", got " << result << "\n";
+                    failCounts[index]++;
+                } else {
+                    out << " >> Depth " << depth << ": " << result << "\n";
+                }
             }
+            reports[index] = out.str();
         }
+    });
+    destroyThreadPool(&pool);
+
+    int totalTests = 0, failedTests = 0;
+    for (size_t index = 0; index < lines.size(); ++index) {
+        cout << reports[index];
+        totalTests += testCounts[index];
+        failedTests += failCounts[index];
     }
 
     cout << "\nSummary: " << (totalTests - failedTests) << "/" << totalTests << " tests passed.\n";
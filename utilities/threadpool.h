@@ -0,0 +1,159 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool for the offline tools (tuner, perft, datagen). Worker 0 is the thread
+// that calls parallelFor, which works through its own queue while it waits, so a pool of
+// size 1 runs everything inline. Jobs are split into chunks up front and dealt out in
+// contiguous runs; a worker pops from the back of its own queue and, once that is empty,
+// steals from the front of the others. Only one thread may submit jobs to a pool.
+
+// (worker, start, end): worker is 0..size-1 and stable for the duration of the call
+typedef std::function<void(int, size_t, size_t)> PoolBody;
+
+struct PoolTask {
+    const PoolBody *body;
+    size_t start;
+    size_t end;
+    std::atomic<size_t> *remaining;
+};
+
+struct PoolQueue {
+    std::mutex lock;
+    std::deque<PoolTask> tasks;
+};
+
+struct ThreadPool {
+    int size = 1;
+    std::vector<std::thread> threads;
+    std::unique_ptr<PoolQueue[]> queues;
+    std::mutex sleepLock;
+    std::condition_variable wake;
+    std::atomic<size_t> queued{0};
+    bool stopping = false;
+};
+
+static inline bool popPoolTask(ThreadPool *pool, int worker, PoolTask *task) {
+    if (pool->queued.load(std::memory_order_acquire) == 0) return false;
+
+    {
+        PoolQueue &own = pool->queues[worker];
+        std::lock_guard<std::mutex> lock(own.lock);
+        if (!own.tasks.empty()) {
+            *task = own.tasks.back();
+            own.tasks.pop_back();
+            pool->queued--;
+            return true;
+        }
+    }
+
+    for (int i = 1; i < pool->size; ++i) {
+        PoolQueue &victim = pool->queues[(worker + i) % pool->size];
+        std::lock_guard<std::mutex> lock(victim.lock);
+        if (!victim.tasks.empty()) {
+            *task = victim.tasks.front();
+            victim.tasks.pop_front();
+            pool->queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline void runPoolTask(const PoolTask &task, int worker) {
+    (*task.body)(worker, task.start, task.end);
+    task.remaining->fetch_sub(1, std::memory_order_acq_rel);
+}
+
+static inline void poolWorkerLoop(ThreadPool *pool, int worker) {
+    PoolTask task;
+    while (true) {
+        if (popPoolTask(pool, worker, &task)) {
+            runPoolTask(task, worker);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(pool->sleepLock);
+        pool->wake.wait(lock, [pool] { return pool->stopping || pool->queued.load() > 0; });
+        if (pool->stopping) return;
+    }
+}
+
+static inline void initializeThreadPool(ThreadPool *pool, int size) {
+    pool->size = std::max(1, size);
+    pool->queues.reset(new PoolQueue[pool->size]);
+    pool->stopping = false;
+    for (int worker = 1; worker < pool->size; ++worker)
+        pool->threads.emplace_back(poolWorkerLoop, pool, worker);
+}
+
+static inline void destroyThreadPool(ThreadPool *pool) {
+    {
+        std::lock_guard<std::mutex> lock(pool->sleepLock);
+        pool->stopping = true;
+    }
+    pool->wake.notify_all();
+    for (auto &thread : pool->threads) thread.join();
+    pool->threads.clear();
+    pool->queues.reset();
+    pool->size = 1;
+}
+
+// Runs body over [0, count) in chunks of at most grain items and returns when all are done
+static inline void parallelFor(ThreadPool *pool, size_t count, size_t grain, const PoolBody &body) {
+    if (count == 0) return;
+    grain = std::max<size_t>(1, grain);
+    size_t chunks = (count + grain - 1) / grain;
+    if (pool->size == 1 || chunks == 1) {
+        for (size_t start = 0; start < count; start += grain)
+            body(0, start, std::min(count, start + grain));
+        return;
+    }
+
+    std::atomic<size_t> remaining{chunks};
+    for (int worker = 0; worker < pool->size; ++worker) {
+        size_t first = chunks * worker / pool->size;
+        size_t last = chunks * (worker + 1) / pool->size;
+        PoolQueue &queue = pool->queues[worker];
+        std::lock_guard<std::mutex> lock(queue.lock);
+        // Pushed in reverse so the owner pops its run front to back
+        for (size_t chunk = last; chunk-- > first;)
+            queue.tasks.push_back({&body, chunk * grain, std::min(count, (chunk + 1) * grain), &remaining});
+    }
+    {
+        std::lock_guard<std::mutex> lock(pool->sleepLock);
+        pool->queued += chunks;
+    }
+    pool->wake.notify_all();
+
+    PoolTask task;
+    while (remaining.load(std::memory_order_acquire) > 0) {
+        if (popPoolTask(pool, 0, &task)) runPoolTask(task, 0);
+        else std::this_thread::yield();
+    }
+}
+
+// map(start, end) -> T per chunk; the chunk results are combined in index order, so the
+// result does not depend on which worker ran which chunk
+template <typename T, typename Map, typename Combine>
+static inline T parallelReduce(ThreadPool *pool, size_t count, size_t grain, T init, Map map, Combine combine) {
+    grain = std::max<size_t>(1, grain);
+    size_t chunks = (count + grain - 1) / grain;
+    std::vector<T> partials(chunks, init);
+    parallelFor(pool, count, grain, [&](int, size_t start, size_t end) {
+        partials[start / grain] = map(start, end);
+    });
+    T result = init;
+    for (size_t chunk = 0; chunk < chunks; ++chunk) result = combine(result, partials[chunk]);
+    return result;
+}
+
+#endif // THREADPOOL_H